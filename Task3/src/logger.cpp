@@ -1,13 +1,11 @@
 #include "logger.h"
-#include <ctime>
-#include <iomanip>
-#include <sstream>
+#include "timestamp.h"
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 #ifdef _WIN32
 #include <windows.h>
 #else
-#include <sys/time.h>
 #include <unistd.h>
 #endif
 
@@ -58,32 +56,16 @@ void Logger::write_message(const char* message) {
 }
 
 void Logger::get_current_time(std::string& buffer) const {
-#ifdef _WIN32
-    SYSTEMTIME time;
-    GetLocalTime(&time);
-    std::ostringstream oss;
-    oss << std::setw(4) << std::setfill('0') << time.wYear << "-"
-        << std::setw(2) << std::setfill('0') << time.wMonth << "-"
-        << std::setw(2) << std::setfill('0') << time.wDay << " "
-        << std::setw(2) << std::setfill('0') << time.wHour << ":"
-        << std::setw(2) << std::setfill('0') << time.wMinute << ":"
-        << std::setw(2) << std::setfill('0') << time.wSecond << "."
-        << std::setw(3) << std::setfill('0') << time.wMilliseconds;
-    buffer = oss.str();
-#else
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    struct tm* time_info = localtime(&tv.tv_sec);
-    std::ostringstream oss;
-    oss << std::setw(4) << std::setfill('0') << (time_info->tm_year + 1900) << "-"
-        << std::setw(2) << std::setfill('0') << (time_info->tm_mon + 1) << "-"
-        << std::setw(2) << std::setfill('0') << time_info->tm_mday << " "
-        << std::setw(2) << std::setfill('0') << time_info->tm_hour << ":"
-        << std::setw(2) << std::setfill('0') << time_info->tm_min << ":"
-        << std::setw(2) << std::setfill('0') << time_info->tm_sec << "."
-        << std::setw(3) << std::setfill('0') << (tv.tv_usec / 1000);
-    buffer = oss.str();
-#endif
+    auto now = std::chrono::system_clock::now();
+    long long millis = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    char text[TIMESTAMP_BUFFER_SIZE + 4];
+    formatLocalTimestamp(millis / 1000, text, TIMESTAMP_BUFFER_SIZE);
+    int fraction = static_cast<int>(millis % 1000);
+    text[TIMESTAMP_LENGTH] = '.';
+    text[TIMESTAMP_LENGTH + 1] = static_cast<char>('0' + fraction / 100);
+    text[TIMESTAMP_LENGTH + 2] = static_cast<char>('0' + fraction / 10 % 10);
+    text[TIMESTAMP_LENGTH + 3] = static_cast<char>('0' + fraction % 10);
+    buffer.assign(text, TIMESTAMP_LENGTH + 4);
 }
 
 void Logger::write_log(const std::string& message) {
@@ -1,179 +1,218 @@
 #include "data_aggregator.h"
+#include "timestamp.h"
+#include "record_file.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <ctime>
-#include <iomanip>
-#include <numeric>
-#include <sstream>
-#include <random>
+#include <filesystem>
+#include <cstdlib>
+#include <limits>
 
-std::string DataAggregator::getCurrentTimestamp(TimeResolution res) {
-    auto now = std::chrono::system_clock::now();
-    auto in_time_t = std::chrono::system_clock::to_time_t(now);
-    std::tm *tm_time = std::localtime(&in_time_t);
+// Reads the "YYYY-MM-DD HH:MM:SS" at the start of text as local time.
+static bool parseTimestamp(const std::string& text, std::int64_t& epoch) {
+    return text.length() >= TIMESTAMP_LENGTH && parseLocalTimestamp(text.c_str(), TIMESTAMP_LENGTH, epoch);
+}
 
-    if (res == TimeResolution::HOUR) {
-        tm_time->tm_min = 0;
-        tm_time->tm_sec = 0;
-    } else if (res == TimeResolution::DAY) {
-        tm_time->tm_hour = 0;
-        tm_time->tm_min = 0;
-        tm_time->tm_sec = 0;
-    }
+// Splits "YYYY-MM-DD HH:MM:SS [t]" into its epoch and temperature.
+static bool parseLine(const std::string& line, Sample& sample) {
+    if (!parseTimestamp(line, sample.epoch)) return false;
+    size_t startPos = line.find('[', TIMESTAMP_LENGTH);
+    if (startPos == std::string::npos) return false;
+    char* parseEnd = nullptr;
+    sample.temperature = std::strtof(line.c_str() + startPos + 1, &parseEnd);
+    return parseEnd != line.c_str() + startPos + 1 && *parseEnd == ']';
+}
 
-    std::stringstream ss;
-    ss << std::put_time(tm_time, "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+static std::int64_t getSegmentSpan(TimeResolution resolution) {
+    switch (resolution) {
+    case TimeResolution::DAY:
+        return 30 * 24 * 60 * 60;
+    case TimeResolution::HOUR:
+        return 24 * 60 * 60;
+    default:
+        return 60 * 60;
+    }
 }
 
-DataAggregator::DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex) :
-    filename(filename), resolution(res), fileMutex(mutex) {}
+static std::string getStem(const std::string& filename) {
+    return std::filesystem::path(filename).replace_extension().string();
+}
 
-void DataAggregator::addTemperature(float temperature, const std::string& timestamp) {
-    std::lock_guard<std::mutex> lock(fileMutex); 
-    std::ofstream outfile(filename, std::ios_base::app);
-    if (outfile.is_open()) {
-        std::string timestampToWrite = timestamp;
-        if (timestamp.empty()) {
-            timestampToWrite = getCurrentTimestamp(resolution);
-        } else {
-            std::tm t{};
-            std::istringstream ss(timestamp);
-            ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-            if (ss.fail()) {
-                std::cerr << "Invalid timestamp format: " << timestamp << ". Using current time." << std::endl;
-                timestampToWrite = getCurrentTimestamp(resolution);
-            }
-        }
-        outfile << timestampToWrite << " [" << temperature << "]" << std::endl;
-        outfile.close();
-    } else {
-        std::cerr << "Error opening file: " << filename << std::endl;
+static std::unique_ptr<StorageBackend> makeBackend(StorageEngine engine, const std::string& filename,
+                                                   TimeResolution resolution) {
+    std::unique_ptr<StorageBackend> backend = makeFileBackend(engine, getStem(filename), getSegmentSpan(resolution));
+    if (!backend) {
+        std::cerr << "Storage engine " << storageEngineName(engine) << " is not available, using text" << std::endl;
+        backend = makeFileBackend(StorageEngine::TEXT, getStem(filename), getSegmentSpan(resolution));
     }
+    return backend;
 }
 
-float DataAggregator::getAverageTemperature(const std::chrono::system_clock::time_point& startTime, const std::chrono::system_clock::time_point& endTime) {
-    std::lock_guard<std::mutex> lock(fileMutex); 
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return 0.0f;
+std::string DataAggregator::getCurrentTimestamp(TimeResolution res) {
+    std::int64_t now = static_cast<std::int64_t>(std::time(nullptr));
+    std::int64_t local = epochToLocal(now);
+    if (res == TimeResolution::HOUR) {
+        now -= ((local % 3600) + 3600) % 3600;
+    } else if (res == TimeResolution::DAY) {
+        std::int64_t day = 24 * 60 * 60;
+        now = localToEpoch(local - ((local % day) + day) % day);
     }
+    return formatLocalTimestamp(now);
+}
 
-    std::vector<float> temperatures;
-    std::string line;
-    while (std::getline(infile, line)) {
-        if (line.length() >= 19) {
-            std::tm t{};
-            std::istringstream ss(line.substr(0, 19));
-            ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-            if (ss.fail()) continue;
-
-            std::time_t epochTime = mktime(&t);
-            if (epochTime == -1) continue;
-
-            auto fileTime = std::chrono::system_clock::from_time_t(epochTime);
-            if (fileTime >= startTime && fileTime <= endTime) {
-                size_t startPos = line.find('[') + 1;
-                size_t endPos = line.find(']');
-                if (startPos != std::string::npos && endPos != std::string::npos) {
-                    try{
-                        temperatures.push_back(std::stof(line.substr(startPos, endPos - startPos)));
-                    } catch (const std::invalid_argument& e){
-                        std::cerr << "Invalid argument: " << e.what() << '\n';
-                        continue;
-                    } catch (const std::out_of_range& e){
-                        std::cerr << "Out of range: " << e.what() << '\n';
-                        continue;
-                    }
-                }
-            }
+// A memory backend starts out empty, so its summary is not saved.
+DataAggregator::DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex, StorageEngine engine) :
+    filename(filename), resolution(res), fileMutex(mutex), engine(engine),
+    backend(makeBackend(engine, filename, res)),
+    summaries(*backend, getSegmentSpan(res),
+              engine == StorageEngine::MEMORY ? "" : getStem(filename) + "." + storageEngineName(engine) + ".summary") {
+    std::string stem = getStem(filename);
+    std::string directory = stem + "." + storageEngineName(engine);
+    bool fresh = engine != StorageEngine::MEMORY && !std::filesystem::exists(directory);
+
+    // Segments of the earlier "<stem>.txt.d" and "<stem>.bin.d" layout are
+    // the ones sensor 0 of the text and records engines keep.
+    std::string oldDirectory = stem + (engine == StorageEngine::RECORDS ? ".bin.d" : ".txt.d");
+    if (fresh && (engine == StorageEngine::TEXT || engine == StorageEngine::RECORDS) &&
+        std::filesystem::is_directory(oldDirectory)) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::filesystem::rename(oldDirectory, directory + "/0", error);
+        if (error) {
+            std::cerr << "Can't move " << oldDirectory << " to " << directory << ": " << error.message() << std::endl;
         }
+        std::filesystem::remove(directory + "/0/summary", error);
+        fresh = false;
     }
-    infile.close();
 
-    if (temperatures.empty()) return 0.0f;
-    float sum = std::accumulate(temperatures.begin(), temperatures.end(), 0.0f);
-    return sum / temperatures.size();
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (!backend->open()) {
+        std::cerr << "Can't open " << storageEngineName(engine) << " storage for " << filename << std::endl;
+    }
+    if (fresh || engine == StorageEngine::MEMORY) {
+        std::string binaryPath = stem + ".bin";
+        if (engine == StorageEngine::RECORDS && std::filesystem::exists(binaryPath)) {
+            importRecords(binaryPath);
+        } else if (std::filesystem::exists(filename)) {
+            importText(filename);
+        }
+    }
+    summaries.load();
 }
 
-
-std::chrono::system_clock::time_point DataAggregator::getFirstDate() {
+DataAggregator::~DataAggregator() {
     std::lock_guard<std::mutex> lock(fileMutex);
-    std::ifstream infile(filename);
+    backend->flush();
+    summaries.save();
+}
 
-    if (!infile.is_open()) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return std::chrono::system_clock::now();
+// The backends need samples in epoch order.
+bool DataAggregator::appendSample(const Sample& sample, const std::string& timestamp) {
+    if (!backend->append(0, sample)) {
+        std::cerr << "Skipping out-of-order sample at " << timestamp << std::endl;
+        return false;
     }
+    summaries.add(0, sample);
+    return true;
+}
+
+void DataAggregator::importText(const std::string& path) {
+    std::ifstream infile(path);
+    if (!infile.is_open()) return;
 
     std::string line;
-    if (std::getline(infile, line)) {
-        if (line.length() >= 19) { 
-            std::tm t{};
-            std::istringstream ss(line.substr(0, 19));
-            ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-            if (!ss.fail()) { 
-                std::time_t epochTime = mktime(&t);
-                if (epochTime != -1) { 
-                    infile.close();
-                    return std::chrono::system_clock::from_time_t(epochTime); 
-                } else {
-                    std::cerr << "mktime failed\n";
-                }
-            } else {
-                std::cerr << "Parsing date failed\n";
-            }
-        } else {
-            std::cerr << "Line too short to contain date\n";
+    Sample sample;
+    size_t imported = 0;
+    while (std::getline(infile, line)) {
+        if (parseLine(line, sample) && appendSample(sample, line)) {
+            ++imported;
         }
     }
+    backend->flush();
+    std::cout << "Imported " << imported << " samples from " << path << std::endl;
+}
 
-    infile.close();
-    return std::chrono::system_clock::now(); 
+void DataAggregator::importRecords(const std::string& path) {
+    RecordFile source(path);
+    size_t count = source.size();
+    size_t imported = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Record record = source.at(i);
+        if (appendSample(Sample{record.epoch, record.temperature}, formatLocalTimestamp(record.epoch))) {
+            ++imported;
+        }
+    }
+    backend->flush();
+    std::cout << "Imported " << imported << " samples from " << path << std::endl;
 }
 
-std::chrono::system_clock::time_point DataAggregator::getLastDate() {
+bool DataAggregator::exportText(const std::string& path) {
     std::lock_guard<std::mutex> lock(fileMutex);
-    std::ifstream infile(filename);
+    std::ofstream outfile(path, std::ios_base::trunc | std::ios_base::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening file for writing: " << path << std::endl;
+        return false;
+    }
+    char timestamp[TIMESTAMP_BUFFER_SIZE];
+    std::unique_ptr<SampleCursor> cursor = backend->scan(0, std::numeric_limits<std::int64_t>::min(),
+                                                         std::numeric_limits<std::int64_t>::max());
+    for (Sample sample; cursor->next(sample);) {
+        formatLocalTimestamp(sample.epoch, timestamp, sizeof(timestamp));
+        outfile << timestamp << " [" << static_cast<float>(sample.temperature) << "]\n";
+    }
+    return static_cast<bool>(outfile);
+}
 
-    if (!infile.is_open()) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return getDefaultTime();
+void DataAggregator::addTemperature(float temperature, const std::string& timestamp) {
+    std::lock_guard<std::mutex> lock(fileMutex); 
+    std::string timestampToWrite = timestamp;
+    Sample sample{0, temperature};
+    if (timestamp.empty() || !parseTimestamp(timestamp, sample.epoch)) {
+        if (!timestamp.empty()) {
+            std::cerr << "Invalid timestamp format: " << timestamp << ". Using current time." << std::endl;
+        }
+        timestampToWrite = getCurrentTimestamp(resolution);
+        parseTimestamp(timestampToWrite, sample.epoch);
+    }
+    if (appendSample(sample, timestampToWrite)) {
+        backend->flush();
     }
+}
 
-    std::string line;
-    std::chrono::system_clock::time_point lastDate = std::chrono::system_clock::now(); 
-    bool dateFound = false;
+// Both ends are included.
+float DataAggregator::getAverageTemperature(const std::chrono::system_clock::time_point& startTime, const std::chrono::system_clock::time_point& endTime) {
+    std::lock_guard<std::mutex> lock(fileMutex); 
+    std::int64_t start = static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(startTime));
+    std::int64_t end = static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(endTime));
 
-    while (std::getline(infile, line)) {
-        if (line.length() >= 19) {
-            std::tm t{};
-            std::istringstream ss(line.substr(0, 19));
-            ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
+    Bucket range = backend->summarize(0, start, end + 1);
+    if (range.count == 0) return 0.0f;
+    return static_cast<float>(range.sum / range.count);
+}
 
-            if (!ss.fail()) {
-                std::time_t epochTime = mktime(&t);
-                if (epochTime != -1) {
-                    lastDate = std::chrono::system_clock::from_time_t(epochTime);
-                    dateFound = true;
-                } else {
-                    std::cerr << "mktime failed\n";
-                }
-            } else {
-                std::cerr << "Parsing date failed for line: " << line << "\n";
-            }
-        }
-    }
 
-    infile.close();
+std::chrono::system_clock::time_point DataAggregator::getFirstDate() {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    const SeriesSummary& summary = summaries.get(0);
+    if (summary.count == 0) {
+        return std::chrono::system_clock::now();
+    }
+    return std::chrono::system_clock::from_time_t(static_cast<std::time_t>(summary.first));
+}
 
-    if (!dateFound) {
+std::chrono::system_clock::time_point DataAggregator::getLastDate() {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    const SeriesSummary& summary = summaries.get(0);
+    if (summary.count == 0) {
         return getDefaultTime();
     }
+    return std::chrono::system_clock::from_time_t(static_cast<std::time_t>(summary.last));
+}
 
-    return lastDate;
+SeriesSummary DataAggregator::getSummary() {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    return summaries.get(0);
 }
 
 std::chrono::system_clock::time_point DataAggregator::getDefaultTime() const {
@@ -188,93 +227,26 @@ std::chrono::system_clock::time_point DataAggregator::getDefaultTime() const {
     }
 }
 
-void DataAggregator::removeOutdated() {
-    std::lock_guard<std::mutex> lock(fileMutex); 
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return;
-    }
-
-    std::vector<std::string> lines;
-    std::string line;
-
-    auto now = std::chrono::system_clock::now();
-    std::chrono::seconds timeThreshold;
+std::chrono::seconds DataAggregator::getRetention() const {
     switch (resolution) {
     case TimeResolution::DAY:
-        timeThreshold = std::chrono::hours(24 * 365);
-        break;
+        return std::chrono::hours(24 * 365);
     case TimeResolution::HOUR:
-        timeThreshold = std::chrono::hours(24 * 30);
-        break;
-    case TimeResolution::CURRENT:
-        timeThreshold = std::chrono::hours(24);
-        break;
-    }
-
-    if (std::getline(infile, line)) {
-        if (line.length() >= 19) {
-            std::tm t{};
-            std::istringstream ss(line.substr(0, 19));
-            ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-            if (ss.fail()) {
-                std::cerr << "Parsing failed\n";
-            }
-            std::time_t epochTime = mktime(&t);
-            if (epochTime == -1) {
-                std::cerr << "mktime failed\n";
-            }
-
-            auto fileTime = std::chrono::system_clock::from_time_t(epochTime);
-
-            if (now - fileTime <= timeThreshold) {
-                infile.close();
-                return;
-            }
-        }
-
-        lines.push_back(line);
-    }
-
-    while (std::getline(infile, line)) {
-        lines.push_back(line);
-    }
-    infile.close();
-
-    std::ofstream outfile(filename);
-    if (!outfile.is_open()) {
-        std::cerr << "Error opening file for writing: " << filename << std::endl;
-        return;
+        return std::chrono::hours(24 * 30);
+    default:
+        return std::chrono::hours(24);
     }
+}
 
-    bool stillUnActual = true;
-    for (const auto& l : lines) {
-        if (l.length() >= 19) {
-            if (stillUnActual) {
-                std::tm t{};
-                std::istringstream ss(l.substr(0, 19));
-                ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-                if (ss.fail()) {
-                    std::cerr << "Parsing failed\n";
-                    continue;
-                }
-                std::time_t epochTime = mktime(&t);
-                if (epochTime == -1) {
-                    std::cerr << "mktime failed\n";
-                    continue;
-                }
-
-                auto fileTime = std::chrono::system_clock::from_time_t(epochTime);
-                
-                if (now - fileTime <= timeThreshold) {
-                    outfile << l << std::endl;
-                    stillUnActual = false;
-                }
-            } else {
-                outfile << l << std::endl;
-            }
-        }
-    }
-    outfile.close();
-}
\ No newline at end of file
+// The cut is made at the start of a segment, so up to one segment span of
+// samples older than the retention period stays around.
+void DataAggregator::removeOutdated() {
+    std::lock_guard<std::mutex> lock(fileMutex); 
+    std::int64_t span = getSegmentSpan(resolution);
+    std::int64_t cutoff = static_cast<std::int64_t>(
+        std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() - getRetention()));
+    cutoff = backend->dropBoundary(cutoff - ((cutoff % span) + span) % span);
+    backend->dropBefore(cutoff);
+    summaries.dropBefore(cutoff);
+    summaries.save();
+}
@@ -4,6 +4,11 @@
 #include <string>
 #include <chrono>
 #include <mutex>
+#include <memory>
+#include <ctime>
+#include <cstdint>
+#include "storage_backend.h"
+#include "summary_store.h"
 
 enum class TimeResolution {
     DAY,
@@ -11,26 +16,48 @@ enum class TimeResolution {
     CURRENT
 };
 
+// The samples are kept as sensor 0 of a StorageBackend (see common/storage)
+// in the directory named after filename with its extension replaced by the
+// engine name, e.g. data_current.text. The text and records engines split
+// them into segments of an hour for CURRENT, a day for HOUR and 30 days for
+// DAY. On first start the old single data file, if any, is imported.
 class DataAggregator {
 private:
     std::string filename;
     TimeResolution resolution;
     std::mutex& fileMutex;
+    StorageEngine engine;
+    std::unique_ptr<StorageBackend> backend;
+    SummaryStore summaries;
 
     std::string getCurrentTimestamp(TimeResolution res);
     std::chrono::system_clock::time_point getDefaultTime() const;
+    std::chrono::seconds getRetention() const;
+
+    bool appendSample(const Sample& sample, const std::string& timestamp);
+    void importText(const std::string& path);
+    void importRecords(const std::string& path);
 
 public:
-    DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex);
+    DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex,
+                   StorageEngine engine = StorageEngine::TEXT);
 
     void addTemperature(float temperature, const std::string& timestamp = "");
 
     float getAverageTemperature(const std::chrono::system_clock::time_point& startTime, const std::chrono::system_clock::time_point& endTime);
 
+    // Served from a SummaryStore with a slice per segment, saved to
+    // "<stem>.<engine>.summary".
     std::chrono::system_clock::time_point getFirstDate();
     std::chrono::system_clock::time_point getLastDate();
+    SeriesSummary getSummary();
 
     void removeOutdated();
+
+    // Writes every sample as a text line to path; for reading binary files.
+    bool exportText(const std::string& path);
+
+    ~DataAggregator();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -10,11 +10,23 @@
 #include <iomanip>
 #include <algorithm>
 #include "data_aggregator.h"
+#include "timestamp.h"
 
 #define DATA_CURRENT "data_current.txt"
 #define DATA_HOUR "data_hour.txt"
 #define DATA_DAY "day_day.txt"
 
+// "prog --export [directory]" writes these, never the names above: those are
+// imported again on the next start.
+#define EXPORT_CURRENT "data_current.export.txt"
+#define EXPORT_HOUR "data_hour.export.txt"
+#define EXPORT_DAY "day_day.export.txt"
+
+// TEXT keeps readable segment files in data_current.text etc. RECORDS,
+// BLOCKS and MEMORY are the other engines in common/storage; for those
+// "prog --export" writes text copies for reading.
+#define STORAGE_ENGINE StorageEngine::TEXT
+
 #if defined(_WIN32)
     #include <windows.h>
     #include <tchar.h>
@@ -30,6 +42,8 @@
 #define PORT_NAME "/dev/pts/4" 
 #endif
 
+#define DAY_SECONDS (24 * 60 * 60)
+
 #define FLOAT_REGEX R"(\[([-+]?\d{1,2}\.\d+)\])"
 
 
@@ -49,9 +63,9 @@ std::mutex dayMutex;
 std::mutex hourMutex;
 std::mutex currentMutex;
 
-DataAggregator aggregatorDay(DATA_DAY, TimeResolution::DAY, dayMutex);
-DataAggregator aggregatorHour(DATA_HOUR, TimeResolution::HOUR, hourMutex);
-DataAggregator aggregatorCurrent(DATA_CURRENT, TimeResolution::CURRENT, currentMutex);
+DataAggregator aggregatorDay(DATA_DAY, TimeResolution::DAY, dayMutex, STORAGE_ENGINE);
+DataAggregator aggregatorHour(DATA_HOUR, TimeResolution::HOUR, hourMutex, STORAGE_ENGINE);
+DataAggregator aggregatorCurrent(DATA_CURRENT, TimeResolution::CURRENT, currentMutex, STORAGE_ENGINE);
 
 
 void monitorCurrentTemperature() {
@@ -114,6 +128,15 @@ void monitorCurrentTemperature() {
 #endif
 }
 
+// Start of the local hour, or of the local day for a day step, containing epoch.
+std::int64_t localPeriodStart(std::int64_t epoch, std::chrono::hours timeStep) {
+    std::int64_t local = epochToLocal(epoch);
+    if (timeStep == std::chrono::hours(24)) {
+        return localToEpoch(local - ((local % DAY_SECONDS) + DAY_SECONDS) % DAY_SECONDS);
+    }
+    return epoch - ((local % 3600) + 3600) % 3600;
+}
+
 void monitorTemperature(
     DataAggregator& aggregatorSource,
     DataAggregator& aggregatorDest,
@@ -124,48 +147,20 @@ void monitorTemperature(
     auto lastTime = aggregatorDest.getLastDate() + timeStep;
 
     auto startTime = (firstTime > lastTime) ? firstTime : lastTime;
+    startTime = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(
+        localPeriodStart(std::chrono::system_clock::to_time_t(startTime), timeStep)));
 
-    std::time_t startTime_t = std::chrono::system_clock::to_time_t(startTime);
-    std::tm* startTimeTM = std::localtime(&startTime_t);
-    if (startTimeTM) {
-        startTimeTM->tm_min = 0;
-        startTimeTM->tm_sec = 0;
-        if (timeStep == std::chrono::hours(24)) {
-           startTimeTM->tm_hour = 0;
-        }
-        startTime = std::chrono::system_clock::from_time_t(mktime(startTimeTM));
-    } else {
-        std::cerr << "localtime failed\n";
-        startTime = std::chrono::system_clock::now();
-    }
-
-    auto now = std::chrono::system_clock::now();
-    auto currentTime = std::chrono::system_clock::to_time_t(now);
-
-    std::tm* currentTimeTM = std::localtime(&currentTime);
-    if (currentTimeTM) {
-        currentTimeTM->tm_min = 0;
-        currentTimeTM->tm_sec = 0;
-        if (timeStep == std::chrono::hours(24)) {
-            currentTimeTM->tm_hour = 0;
-        }
-    } else {
-        std::cerr << "localtime failed\n";
-        return;
-    }
-
-    auto endLoopTime = std::chrono::system_clock::from_time_t(mktime(currentTimeTM));
+    auto endLoopTime = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(
+        localPeriodStart(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()), timeStep)));
 
+    char timestamp[TIMESTAMP_BUFFER_SIZE];
     for (auto currentTimePoint = startTime; currentTimePoint < endLoopTime; currentTimePoint += timeStep) {
         auto nextTimePoint = currentTimePoint + timeStep;
         float avgTemp = aggregatorSource.getAverageTemperature(currentTimePoint, nextTimePoint);
 
-        std::time_t tt = std::chrono::system_clock::to_time_t(currentTimePoint);
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&tt), "%Y-%m-%d %H:%M:%S");
-
-        aggregatorDest.addTemperature(avgTemp, ss.str());
-        std::cout << "Added to " << aggregatorName << " aggregator: " << ss.str() << " [" << avgTemp << "]" << std::endl;
+        formatLocalTimestamp(std::chrono::system_clock::to_time_t(currentTimePoint), timestamp, sizeof(timestamp));
+        aggregatorDest.addTemperature(avgTemp, timestamp);
+        std::cout << "Added to " << aggregatorName << " aggregator: " << timestamp << " [" << avgTemp << "]" << std::endl;
     }
 }
 
@@ -196,7 +191,15 @@ void removeUnactualTemperature() {
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--export") {
+        std::string directory = argc > 2 ? std::string(argv[2]) + "/" : "";
+        bool exported = aggregatorCurrent.exportText(directory + EXPORT_CURRENT) &&
+                        aggregatorHour.exportText(directory + EXPORT_HOUR) &&
+                        aggregatorDay.exportText(directory + EXPORT_DAY);
+        return exported ? 0 : 1;
+    }
+
     std::thread currentTemperatureThread(monitorCurrentTemperature);
     std::thread hourTemperatureThread(monitorHourTemperature);
     std::thread dayTemperatureThread(monitorDayTemperature);
@@ -3,37 +3,68 @@ import requests
 import matplotlib.pyplot as plt
 from io import BytesIO
 import base64
+import struct
+import threading
+from collections import OrderedDict
 from datetime import datetime
 
 app = Flask(__name__)
+# requests.Session is not thread-safe, so each Flask worker thread gets its own.
+local = threading.local()
+
+# Width in pixels of the plots made by create_plot; the server downsamples to it.
+PLOT_POINTS = 1000
+
+# Last response per query, revalidated with If-None-Match so unchanged data is not resent.
+# Only the ETAG_CACHE_SIZE most recently used queries are kept.
+ETAG_CACHE_SIZE = 64
+etag_cache = OrderedDict()
+etag_lock = threading.Lock()
+
+def get_session():
+    if not hasattr(local, "session"):
+        local.session = requests.Session()
+    return local.session
+
+def cached_response(key):
+    with etag_lock:
+        if key not in etag_cache:
+            return None
+        etag_cache.move_to_end(key)
+        return etag_cache[key]
+
+def cache_response(key, etag, data):
+    with etag_lock:
+        etag_cache[key] = (etag, data)
+        etag_cache.move_to_end(key)
+        while len(etag_cache) > ETAG_CACHE_SIZE:
+            etag_cache.popitem(last=False)
 
 def fetch_data(params):
     url = "http://localhost:8080/data"
+    key = tuple(sorted(params.items()))
+    headers = {}
+    cached = cached_response(key)
+    if cached:
+        headers["If-None-Match"] = cached[0]
     try:
-        response = requests.get(url, params=params)
+        response = get_session().get(url, params={**params, "format": "binary"}, headers=headers)
+        if response.status_code == 304 and cached:
+            return cached[1]
         response.raise_for_status()
 
-        if "Temperature data:" in response.text or "Latest record:" in response.text:
-            data = []
-            lines = response.text.splitlines()
-            if len(lines) > 1:
-                for line in lines:
-                    if line.startswith("Date:"):
-                        parts = line.split(", ")
-                        date_str = parts[0].split(": ")[1]
-                        temperature = float(parts[1].split(": ")[1])
-                        try:
-                            data.append((datetime.strptime(date_str, "%Y-%m-%d %H:%M:%S"), temperature))
-                        except ValueError as e:
-                            print(f"Error parsing date: {e}, Line: {line}")
-                            return None
-            else:
-                print(f"Empty data after 'Temperature data:' for {params}")
-                return None
-            return data
-        else:
+        if response.headers.get("Content-Type") != "application/octet-stream":
             print(f"Unexpected response format for {params}: {response.text}")
             return None
+        if not response.content:
+            print(f"Empty data for {params}")
+            return None
+
+        data = [(datetime.fromtimestamp(epoch), temperature)
+                for epoch, temperature in struct.iter_unpack("<qf", response.content)]
+        if "ETag" in response.headers:
+            cache_response(key, response.headers["ETag"], data)
+        return data
 
     except requests.exceptions.RequestException as e:
         print(f"Error fetching data: {e}")
@@ -79,7 +110,7 @@ def get_current_temperature():
     if data:
         return jsonify({
             "date": data[0][0].strftime("%Y-%m-%d %H:%M:%S"),
-            "temperature": data[0][1]
+            "temperature": round(data[0][1], 2)
         })
     return jsonify({"error": "No data found"}), 404
 
@@ -90,7 +121,7 @@ def get_graphs():
     tables = ["data_current", "data_hour", "data_day"]
     graphs = {}
     for table in tables:
-        params = {"start": start_date, "end": end_date, "table": table}
+        params = {"start": start_date, "end": end_date, "table": table, "points": PLOT_POINTS}
         data = fetch_data(params)
         if data:
             graph_data = create_plot(data, f"Data from {table}")
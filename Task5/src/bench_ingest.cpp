@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <sqlite3.h>
+#include "connection_manager.h"
+#include "schema.h"
+#include "ingest_queue.h"
+
+#define BENCH_DB "bench_ingest.db"
+#define BENCH_TABLE "data_current"
+#define AUTOCOMMIT_COUNT 2000
+#define GROUP_COUNT 200000
+#define QUEUE_COUNT 1000000
+#define QUEUE_CAPACITY 4096
+
+// Measures sustained single-row ingest through ConnectionManager with every
+// insert committed on its own and with group commit at a few batch sizes,
+// then the IngestQueue push latency seen by a producer while the consumer
+// stalls for 20 ms after every 10000 samples, as a slow write would.
+
+static double ingest(ConnectionManager& connections, int count, sqlite3_int64 firstEpoch) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        std::lock_guard<std::mutex> lock(connections.getWriterMutex());
+        CachedStatement statement = connections.getWriterStatements().get(BENCH_TABLE, QueryKind::INSERT);
+        sqlite3_bind_int(statement.get(), 1, 0);
+        sqlite3_bind_int64(statement.get(), 2, firstEpoch + i);
+        sqlite3_bind_double(statement.get(), 3, 20.0 + i % 10);
+        connections.beginWrite();
+        sqlite3_step(statement.get());
+        connections.endWrite();
+    }
+    connections.flushWrites();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return count / elapsed.count();
+}
+
+static void report(const std::string& name, double rate) {
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << rate << " rows/s" << std::endl;
+}
+
+static void queueLatency(const std::string& name, OverflowPolicy policy) {
+    IngestQueue queue(QUEUE_CAPACITY, policy);
+    std::atomic<bool> done(false);
+    std::thread consumer([&]() {
+        Reading reading;
+        std::uint64_t count = 0;
+        while (!done.load() || queue.depth() > 0) {
+            if (queue.pop(reading, std::chrono::milliseconds(10)) && ++count % 10000 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+    });
+
+    std::vector<double> latencies;
+    latencies.reserve(QUEUE_COUNT);
+    for (int i = 0; i < QUEUE_COUNT; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        queue.push(Reading{0, Sample{i, 20.0}});
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    done.store(true);
+    consumer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    IngestQueueStats stats = queue.stats();
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+              << "p50 " << latencies[latencies.size() / 2] << " us, p99.9 " << latencies[latencies.size() * 999 / 1000]
+              << " us, max " << latencies.back() << " us, dropped " << stats.droppedOldest + stats.droppedNewest
+              << ", max depth " << stats.maxDepth << std::endl;
+}
+
+int main() {
+    std::remove(BENCH_DB);
+    {
+        ConnectionManager connections(BENCH_DB);
+        if (!connections.getWriter()) {
+            return 1;
+        }
+        ensureTable(connections.getWriter(), BENCH_TABLE);
+
+        report("autocommit", ingest(connections, AUTOCOMMIT_COUNT, 0));
+
+        sqlite3_int64 epoch = AUTOCOMMIT_COUNT;
+        const size_t batches[] = {10, 100, 1000};
+        for (size_t rows : batches) {
+            connections.setGroupCommit(rows, std::chrono::milliseconds(1000));
+            report("group commit " + std::to_string(rows), ingest(connections, GROUP_COUNT, epoch));
+            epoch += GROUP_COUNT;
+        }
+    }
+    std::remove(BENCH_DB);
+    std::remove(BENCH_DB "-wal");
+    std::remove(BENCH_DB "-shm");
+
+    queueLatency("queue block", OverflowPolicy::BLOCK);
+    queueLatency("queue drop oldest", OverflowPolicy::DROP_OLDEST);
+    queueLatency("queue drop newest", OverflowPolicy::DROP_NEWEST);
+    return 0;
+}
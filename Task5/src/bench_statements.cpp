@@ -0,0 +1,141 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include <ctime>
+#include <sqlite3.h>
+#include "statement_cache.h"
+
+#define BENCH_DB "bench_statements.db"
+#define BENCH_TABLE "data_current"
+#define INSERT_COUNT 50000
+#define QUERY_COUNT 20000
+
+// Compares the old prepare/step/finalize-per-call path with StatementCache for
+// the aggregator's hot queries. Inserts run inside one transaction so that the
+// numbers show statement overhead rather than commit cost.
+
+static sqlite3_int64 epochFor(int i) {
+    return 1700000000 + i;
+}
+
+static double measure(int count, const std::function<void(int)>& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        body(i);
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+}
+
+static void report(const std::string& name, double uncached, double cached) {
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(14) << uncached << " us" << std::setw(14) << cached << " us"
+              << std::setw(10) << std::setprecision(1) << uncached / cached << "x" << std::endl;
+}
+
+static void reset(sqlite3* db) {
+    sqlite3_exec(db, "DROP TABLE IF EXISTS \"" BENCH_TABLE "\"", nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "CREATE TABLE \"" BENCH_TABLE "\" (sensor_id INTEGER NOT NULL, epoch INTEGER NOT NULL, "
+                     "temperature REAL, PRIMARY KEY (sensor_id, epoch)) WITHOUT ROWID", nullptr, nullptr, nullptr);
+}
+
+int main() {
+    std::remove(BENCH_DB);
+    sqlite3* db = nullptr;
+    if (sqlite3_open(BENCH_DB, &db) != SQLITE_OK) {
+        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        return 1;
+    }
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr);
+
+
+    reset(db);
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    double insertUncached = measure(INSERT_COUNT, [&](int i) {
+        std::string sql = buildQuery(BENCH_TABLE, QueryKind::INSERT);
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, 0);
+        sqlite3_bind_int64(stmt, 2, epochFor(i));
+        sqlite3_bind_double(stmt, 3, 20.0 + i % 10);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    });
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+
+    reset(db);
+    double insertCached;
+    {
+        StatementCache statements(db);
+        sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+        insertCached = measure(INSERT_COUNT, [&](int i) {
+            CachedStatement statement = statements.get(BENCH_TABLE, QueryKind::INSERT);
+            sqlite3_bind_int(statement.get(), 1, 0);
+            sqlite3_bind_int64(statement.get(), 2, epochFor(i));
+            sqlite3_bind_double(statement.get(), 3, 20.0 + i % 10);
+            sqlite3_step(statement.get());
+        });
+        sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+    }
+
+    auto queryBounds = [&](int i, sqlite3_int64& start, sqlite3_int64& end) {
+        int first = (i * 37) % (INSERT_COUNT - 60);
+        start = epochFor(first);
+        end = epochFor(first + 60);
+    };
+
+    double averageUncached = measure(QUERY_COUNT, [&](int i) {
+        sqlite3_int64 start, end;
+        queryBounds(i, start, end);
+        std::string sql = buildQuery(BENCH_TABLE, QueryKind::AVERAGE);
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, 0);
+        sqlite3_bind_int64(stmt, 2, start);
+        sqlite3_bind_int64(stmt, 3, end);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    });
+
+    double lastUncached = measure(QUERY_COUNT, [&](int) {
+        std::string sql = buildQuery(BENCH_TABLE, QueryKind::LAST_DATE);
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, 0);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    });
+
+    double averageCached, lastCached;
+    {
+        StatementCache statements(db);
+        averageCached = measure(QUERY_COUNT, [&](int i) {
+            sqlite3_int64 start, end;
+            queryBounds(i, start, end);
+            CachedStatement statement = statements.get(BENCH_TABLE, QueryKind::AVERAGE);
+            sqlite3_bind_int(statement.get(), 1, 0);
+            sqlite3_bind_int64(statement.get(), 2, start);
+            sqlite3_bind_int64(statement.get(), 3, end);
+            sqlite3_step(statement.get());
+        });
+        lastCached = measure(QUERY_COUNT, [&](int) {
+            CachedStatement statement = statements.get(BENCH_TABLE, QueryKind::LAST_DATE);
+            sqlite3_bind_int(statement.get(), 1, 0);
+            sqlite3_step(statement.get());
+        });
+    }
+
+    std::cout << std::left << std::setw(10) << "query" << std::right
+              << std::setw(17) << "prepare/call" << std::setw(17) << "cached" << std::setw(11) << "speedup" << std::endl;
+    report("insert", insertUncached, insertCached);
+    report("average", averageUncached, averageCached);
+    report("last", lastUncached, lastCached);
+
+    sqlite3_close(db);
+    std::remove(BENCH_DB);
+    return 0;
+}
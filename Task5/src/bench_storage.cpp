@@ -0,0 +1,282 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <filesystem>
+#include <mutex>
+#include "connection_manager.h"
+#include "sqlite_backend.h"
+
+#define BENCH_DB "bench_storage.db"
+#define BENCH_TABLE "bench_storage"
+#define CONFORMANCE_SAMPLES 5000
+#define BENCH_SAMPLES (3 * 24 * 60 * 60)
+#define QUERY_COUNT 20
+#define DAY_SECONDS (24 * 60 * 60)
+
+// Runs the same conformance checks and benchmark against every storage
+// engine, or against the engines named on the command line. The data is 1 Hz
+// readings from a slow random walk, rounded to two decimals like the serial
+// devices send them. Exits with 1 if any check fails.
+
+static int failures = 0;
+
+static void check(StorageEngine engine, const std::string& name, bool ok) {
+    if (!ok) {
+        std::cout << "FAIL " << storageEngineName(engine) << ": " << name << std::endl;
+        ++failures;
+    }
+}
+
+static std::vector<Sample> makeSamples(int count, std::int64_t first, unsigned int seed) {
+    std::vector<Sample> samples(count);
+    std::mt19937 random(seed);
+    std::normal_distribution<float> step(0.0f, 0.05f);
+    float value = 21.0f;
+    std::int64_t epoch = first;
+    for (Sample& sample : samples) {
+        value += step(random);
+        // Every 500th reading is late by a minute, as after a dropped connection.
+        epoch += random() % 500 == 0 ? 60 : 1;
+        sample = Sample{epoch, static_cast<float>(static_cast<int>(value * 100.0f)) / 100.0f};
+    }
+    return samples;
+}
+
+static void removeFiles() {
+    std::remove(BENCH_DB);
+    std::remove(BENCH_DB "-wal");
+    std::remove(BENCH_DB "-shm");
+    std::filesystem::remove_all(BENCH_TABLE ".text");
+    std::filesystem::remove_all(BENCH_TABLE ".records");
+    std::filesystem::remove_all(BENCH_TABLE ".blocks");
+}
+
+static std::uint64_t diskBytes() {
+    std::uint64_t total = 0;
+    for (const char* path : {BENCH_DB, BENCH_DB "-wal", BENCH_TABLE ".text", BENCH_TABLE ".records",
+                             BENCH_TABLE ".blocks"}) {
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error)) {
+                if (entry.is_regular_file(error)) {
+                    total += entry.file_size(error);
+                }
+            }
+        } else if (std::filesystem::exists(path, error)) {
+            total += std::filesystem::file_size(path, error);
+        }
+    }
+    return total;
+}
+
+static std::vector<Sample> scanAll(const StorageBackend& backend, int sensor, std::int64_t start, std::int64_t end) {
+    std::vector<Sample> output;
+    std::unique_ptr<SampleCursor> cursor = backend.scan(sensor, start, end);
+    for (Sample sample; cursor->next(sample);) {
+        output.push_back(sample);
+    }
+    return output;
+}
+
+static bool sameSamples(const std::vector<Sample>& actual, std::vector<Sample>::const_iterator first,
+                        std::vector<Sample>::const_iterator last) {
+    if (actual.size() != static_cast<size_t>(last - first)) {
+        return false;
+    }
+    for (const Sample& sample : actual) {
+        if (sample.epoch != first->epoch || std::fabs(sample.temperature - first->temperature) > 1e-3) {
+            return false;
+        }
+        ++first;
+    }
+    return true;
+}
+
+static std::vector<Sample>::const_iterator lowerBound(const std::vector<Sample>& samples, std::int64_t epoch) {
+    auto it = samples.begin();
+    while (it != samples.end() && it->epoch < epoch) {
+        ++it;
+    }
+    return it;
+}
+
+static void runConformance(StorageEngine engine, ConnectionManager& connections) {
+    std::mutex& writerMutex = connections.getWriterMutex();
+    std::vector<Sample> zero = makeSamples(CONFORMANCE_SAMPLES, 1700000000, 1);
+    std::vector<Sample> one = makeSamples(CONFORMANCE_SAMPLES / 2, 1700000000, 2);
+    std::int64_t lastEpoch = zero.back().epoch;
+
+    {
+        std::unique_ptr<StorageBackend> backend = makeStorageBackend(engine, BENCH_TABLE, connections);
+        check(engine, "open", backend->open());
+
+        Sample sample;
+        check(engine, "empty first", !backend->firstSample(0, sample));
+        check(engine, "empty last", !backend->lastSample(0, sample));
+        check(engine, "empty scan", scanAll(*backend, 0, 0, lastEpoch).empty());
+        check(engine, "empty summary", backend->summarize(0, 0, lastEpoch).count == 0);
+
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            bool accepted = true;
+            for (size_t i = 0; i < zero.size() / 2; ++i) {
+                accepted = backend->append(0, zero[i]) && accepted;
+            }
+            backend->flush();
+            std::vector<Sample> rest(zero.begin() + zero.size() / 2, zero.end());
+            check(engine, "append", accepted);
+            check(engine, "append batch", backend->appendBatch(0, rest) == rest.size());
+            check(engine, "append other sensor", backend->appendBatch(1, one) == one.size());
+        }
+        connections.flushWrites();
+
+        check(engine, "full scan", sameSamples(scanAll(*backend, 0, 0, lastEpoch), zero.begin(), zero.end()));
+        check(engine, "other sensor scan", sameSamples(scanAll(*backend, 1, 0, lastEpoch), one.begin(), one.end()));
+        check(engine, "unknown sensor scan", scanAll(*backend, 7, 0, lastEpoch).empty());
+
+        std::int64_t from = zero[1000].epoch, to = zero[3000].epoch;
+        check(engine, "inclusive range", sameSamples(scanAll(*backend, 0, from, to), zero.begin() + 1000, zero.begin() + 3001));
+
+        Bucket summary = backend->summarize(0, from, to);
+        double sum = 0.0, min = zero[1000].temperature, max = zero[1000].temperature;
+        for (auto it = zero.begin() + 1000; it != zero.begin() + 3000; ++it) {
+            sum += it->temperature;
+            min = std::min(min, it->temperature);
+            max = std::max(max, it->temperature);
+        }
+        check(engine, "summary count", summary.count == 2000);
+        check(engine, "summary sum", std::fabs(summary.sum - sum) < 0.01);
+        check(engine, "summary min/max", std::fabs(summary.min - min) < 1e-3 && std::fabs(summary.max - max) < 1e-3);
+
+        check(engine, "first", backend->firstSample(0, sample) && sample.epoch == zero.front().epoch);
+        check(engine, "last", backend->lastSample(0, sample) && sample.epoch == lastEpoch);
+        check(engine, "other sensor last", backend->lastSample(1, sample) && sample.epoch == one.back().epoch);
+
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            if (engine != StorageEngine::SQLITE) {
+                check(engine, "rejects old sample", !backend->append(0, zero[10]));
+            }
+        }
+    }
+
+    if (engine == StorageEngine::MEMORY) {
+        return;
+    }
+
+    std::unique_ptr<StorageBackend> backend = makeStorageBackend(engine, BENCH_TABLE, connections);
+    check(engine, "reopen", backend->open());
+    check(engine, "scan after reopen", sameSamples(scanAll(*backend, 0, 0, lastEpoch), zero.begin(), zero.end()));
+    Sample next{lastEpoch + 1, 20.25};
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        check(engine, "append after reopen", backend->append(0, next));
+        backend->flush();
+    }
+    connections.flushWrites();
+    Sample sample;
+    check(engine, "last after reopen", backend->lastSample(0, sample) && sample.epoch == next.epoch);
+
+    std::int64_t cutoff = zero.front().epoch + DAY_SECONDS / 24;
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        backend->dropBefore(cutoff);
+    }
+    connections.flushWrites();
+    std::vector<Sample> kept = scanAll(*backend, 0, 0, lastEpoch);
+    check(engine, "drop keeps newer samples", !kept.empty() && kept.back().epoch == lastEpoch &&
+          sameSamples(scanAll(*backend, 0, cutoff, lastEpoch), lowerBound(zero, cutoff), zero.end()));
+    check(engine, "drop removes older samples", kept.empty() || kept.front().epoch >= cutoff - DAY_SECONDS);
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static void runBenchmark(StorageEngine engine, ConnectionManager& connections) {
+    std::vector<Sample> samples = makeSamples(BENCH_SAMPLES, 1700000000, 3);
+    std::unique_ptr<StorageBackend> backend = makeStorageBackend(engine, BENCH_TABLE, connections);
+    backend->open();
+
+    // One reading at a time, as the ingest thread stores them.
+    auto start = std::chrono::steady_clock::now();
+    for (const Sample& sample : samples) {
+        std::lock_guard<std::mutex> lock(connections.getWriterMutex());
+        backend->append(0, sample);
+        backend->flush();
+    }
+    connections.flushWrites();
+    double appendSeconds = secondsSince(start);
+
+    double checksum = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < QUERY_COUNT; ++q) {
+        std::int64_t from = samples[(q * 7919) % (BENCH_SAMPLES / 2)].epoch;
+        std::unique_ptr<SampleCursor> cursor = backend->scan(0, from, from + DAY_SECONDS - 1);
+        for (Sample sample; cursor->next(sample);) {
+            checksum += sample.temperature;
+        }
+    }
+    double scanMillis = secondsSince(start) * 1000.0 / QUERY_COUNT;
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < QUERY_COUNT; ++q) {
+        std::int64_t from = samples[(q * 7919) % (BENCH_SAMPLES / 2)].epoch;
+        checksum -= backend->summarize(0, from, from + DAY_SECONDS).sum;
+    }
+    double summaryMillis = secondsSince(start) * 1000.0 / QUERY_COUNT;
+
+    start = std::chrono::steady_clock::now();
+    Sample last;
+    for (int q = 0; q < QUERY_COUNT * 50; ++q) {
+        backend->lastSample(0, last);
+    }
+    double lastMicros = secondsSince(start) * 1e6 / (QUERY_COUNT * 50);
+
+    std::cout << std::left << std::setw(8) << storageEngineName(engine) << std::right << std::fixed
+              << std::setw(12) << std::setprecision(0) << BENCH_SAMPLES / appendSeconds
+              << std::setw(12) << std::setprecision(2) << static_cast<double>(diskBytes()) / BENCH_SAMPLES
+              << std::setw(12) << std::setprecision(3) << scanMillis
+              << std::setw(12) << summaryMillis
+              << std::setw(12) << lastMicros << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<StorageEngine> engines;
+    for (int i = 1; i < argc; ++i) {
+        StorageEngine engine;
+        if (!parseStorageEngine(argv[i], engine)) {
+            std::cerr << "Unknown storage engine: " << argv[i] << std::endl;
+            return 1;
+        }
+        engines.push_back(engine);
+    }
+    if (engines.empty()) {
+        engines = {StorageEngine::SQLITE, StorageEngine::TEXT, StorageEngine::RECORDS, StorageEngine::MEMORY,
+                   StorageEngine::BLOCKS};
+    }
+
+    for (StorageEngine engine : engines) {
+        removeFiles();
+        ConnectionManager connections(BENCH_DB);
+        runConformance(engine, connections);
+    }
+    std::cout << (failures == 0 ? "All conformance checks passed" : "Conformance checks failed") << std::endl;
+
+    std::cout << std::left << std::setw(8) << "engine" << std::right << std::setw(12) << "appends/s"
+              << std::setw(12) << "B/sample" << std::setw(12) << "scan ms" << std::setw(12) << "summary ms"
+              << std::setw(12) << "last us" << std::endl;
+    for (StorageEngine engine : engines) {
+        removeFiles();
+        ConnectionManager connections(BENCH_DB);
+        connections.setGroupCommit(1000, std::chrono::milliseconds(1000));
+        runBenchmark(engine, connections);
+    }
+    removeFiles();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include "timestamp.h"
+
+#define CHECK_START 1672531200
+#define CHECK_SECONDS (2 * 366 * 24 * 60 * 60)
+#define CHECK_STEP 599
+#define BENCH_COUNT 1000000
+
+// Checks the timestamp codec against localtime/mktime over two years in the
+// process's time zone (run it with TZ set to try others), then times parsing
+// and formatting with it, with the sscanf/strftime code it replaced and with
+// the iostream get_time/put_time code of Task4.
+
+static std::tm localTm(std::int64_t epoch) {
+    std::time_t time = static_cast<std::time_t>(epoch);
+    std::tm localTime{};
+#if defined(_WIN32)
+    localtime_s(&localTime, &time);
+#else
+    localtime_r(&time, &localTime);
+#endif
+    return localTime;
+}
+
+static std::string libcFormat(std::int64_t epoch) {
+    std::tm localTime = localTm(epoch);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &localTime);
+    return buffer;
+}
+
+static bool libcParse(const char* text, std::int64_t& epoch) {
+    std::tm localTime{};
+    if (std::sscanf(text, "%4d-%2d-%2d %2d:%2d:%2d", &localTime.tm_year, &localTime.tm_mon, &localTime.tm_mday,
+                    &localTime.tm_hour, &localTime.tm_min, &localTime.tm_sec) != 6) {
+        return false;
+    }
+    localTime.tm_year -= 1900;
+    localTime.tm_mon -= 1;
+    localTime.tm_isdst = -1;
+    epoch = static_cast<std::int64_t>(std::mktime(&localTime));
+    return epoch != -1;
+}
+
+static std::string streamFormat(std::int64_t epoch) {
+    std::time_t time = static_cast<std::time_t>(epoch);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+
+static bool streamParse(const std::string& text, std::int64_t& epoch) {
+    std::tm t{};
+    std::istringstream ss(text);
+    ss >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
+    if (ss.fail()) return false;
+    t.tm_isdst = -1;
+    epoch = static_cast<std::int64_t>(mktime(&t));
+    return epoch != -1;
+}
+
+static int runChecks() {
+    int failures = 0, ambiguous = 0, checked = 0;
+    char buffer[TIMESTAMP_BUFFER_SIZE];
+    for (std::int64_t epoch = CHECK_START; epoch < CHECK_START + CHECK_SECONDS; epoch += CHECK_STEP) {
+        // Each step also looks at the seconds around the hour it falls in,
+        // where DST changes happen.
+        for (std::int64_t probe : {epoch, epoch - epoch % 3600 - 1, epoch - epoch % 3600}) {
+            ++checked;
+            std::string expected = libcFormat(probe);
+            formatLocalTimestamp(probe, buffer, sizeof(buffer));
+            if (expected != buffer) {
+                if (failures++ < 5) std::cout << "FAIL format " << probe << ": " << buffer << " != " << expected << std::endl;
+                continue;
+            }
+            std::int64_t parsed = 0, reference = 0;
+            if (!parseLocalTimestamp(buffer, TIMESTAMP_LENGTH, parsed) || !libcParse(buffer, reference)) {
+                if (failures++ < 5) std::cout << "FAIL parse " << buffer << std::endl;
+                continue;
+            }
+            if (parsed != reference) {
+                // A time shown twice when the clocks go back: either reading is right.
+                if (libcFormat(parsed) == expected && libcFormat(reference) == expected) {
+                    ++ambiguous;
+                } else if (failures++ < 5) {
+                    std::cout << "FAIL parse " << buffer << ": " << parsed << " != " << reference << std::endl;
+                }
+            }
+        }
+    }
+
+    const char* invalid[] = {"2024-02-30 00:00:00", "2023-02-29 12:00:00", "2024-13-01 00:00:00",
+                             "2024-01-01 24:00:00", "2024-01-01 00:60:00", "2024-01-01T00:00:00",
+                             "2024-01-0a 00:00:00", "2024/01/01 00:00:00"};
+    for (const char* text : invalid) {
+        std::int64_t epoch;
+        if (parseLocalTimestamp(text, TIMESTAMP_LENGTH, epoch)) {
+            ++failures;
+            std::cout << "FAIL accepted " << text << std::endl;
+        }
+    }
+    std::int64_t leap, next;
+    if (!parseLocalTimestamp("2024-02-29 23:59:60", TIMESTAMP_LENGTH, leap) ||
+        !parseLocalTimestamp("2024-03-01 00:00:00", TIMESTAMP_LENGTH, next) || leap != next) {
+        ++failures;
+        std::cout << "FAIL leap second" << std::endl;
+    }
+
+    std::cout << checked << " timestamps checked, " << ambiguous << " ambiguous, " << failures << " failures" << std::endl;
+    return failures;
+}
+
+static double nanosPerCall(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / BENCH_COUNT;
+}
+
+static void report(const char* name, double formatNanos, double parseNanos) {
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << formatNanos << std::setw(14) << parseNanos << std::endl;
+}
+
+int main() {
+    int failures = runChecks();
+
+    // One reading a second, as the aggregators see them.
+    std::vector<std::string> texts;
+    texts.reserve(BENCH_COUNT);
+    for (int i = 0; i < BENCH_COUNT; ++i) {
+        texts.push_back(formatLocalTimestamp(CHECK_START + i));
+    }
+    std::int64_t checksum = 0;
+    char buffer[TIMESTAMP_BUFFER_SIZE];
+
+    std::cout << std::left << std::setw(16) << "path" << std::right << std::setw(14) << "format ns"
+              << std::setw(14) << "parse ns" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_COUNT; ++i) {
+        checksum += static_cast<std::int64_t>(streamFormat(CHECK_START + i)[18]);
+    }
+    double formatNanos = nanosPerCall(start);
+    start = std::chrono::steady_clock::now();
+    for (const std::string& text : texts) {
+        std::int64_t epoch = 0;
+        streamParse(text, epoch);
+        checksum += epoch;
+    }
+    report("iostream", formatNanos, nanosPerCall(start));
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_COUNT; ++i) {
+        checksum += static_cast<std::int64_t>(libcFormat(CHECK_START + i)[18]);
+    }
+    formatNanos = nanosPerCall(start);
+    start = std::chrono::steady_clock::now();
+    for (const std::string& text : texts) {
+        std::int64_t epoch = 0;
+        libcParse(text.c_str(), epoch);
+        checksum += epoch;
+    }
+    report("sscanf/strftime", formatNanos, nanosPerCall(start));
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_COUNT; ++i) {
+        formatLocalTimestamp(CHECK_START + i, buffer, sizeof(buffer));
+        checksum += buffer[18];
+    }
+    formatNanos = nanosPerCall(start);
+    start = std::chrono::steady_clock::now();
+    for (const std::string& text : texts) {
+        std::int64_t epoch = 0;
+        parseLocalTimestamp(text.c_str(), TIMESTAMP_LENGTH, epoch);
+        checksum += epoch;
+    }
+    report("codec", formatNanos, nanosPerCall(start));
+
+    std::cout << "checksum " << checksum << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+#include "connection_manager.h"
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <limits>
+
+#define DB_PATH "logs.db"
+#define BUSY_TIMEOUT_MS 5000
+#define WAL_AUTOCHECKPOINT_PAGES 1000
+
+ConnectionManager& getConnectionManager() {
+    static ConnectionManager manager(DB_PATH);
+    return manager;
+}
+
+ReadConnection::ReadConnection(ConnectionManager* manager, std::unique_ptr<DatabaseConnection> connection) :
+    manager(manager), connection(std::move(connection)) {}
+
+ReadConnection::ReadConnection(ReadConnection&& other) noexcept :
+    manager(other.manager), connection(std::move(other.connection)) {}
+
+ReadConnection::~ReadConnection() {
+    if (connection) {
+        manager->release(std::move(connection));
+    }
+}
+
+ConnectionManager::ConnectionManager(const std::string& path) :
+    path(path), maxIdleReaders(std::max(4u, 2 * std::thread::hardware_concurrency())), startTime(std::time(nullptr)),
+    groupRows(1), groupDelay(0), pendingRows(0), inTransaction(false), stopping(false) {
+
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(path.c_str(), &db,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return;
+    }
+    sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+
+    char* errmsg = nullptr;
+    if (sqlite3_exec(db, "PRAGMA journal_mode=WAL", nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+    }
+    writer = std::make_unique<DatabaseConnection>(db);
+
+    sqlite3_update_hook(db, onUpdate, this);
+    sqlite3_wal_hook(db, onWalCommit, this);
+}
+
+ConnectionManager::~ConnectionManager() {
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stopping = true;
+    }
+    flushCondition.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+    flushWrites();
+}
+
+void ConnectionManager::setGroupCommit(size_t maxRows, std::chrono::milliseconds maxDelay) {
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (inTransaction) {
+            commitBatch();
+        }
+        groupRows = maxRows;
+        groupDelay = maxDelay;
+    }
+    if (groupRows > 1 && writer && !flusher.joinable()) {
+        flusher = std::thread([this]() { flushLoop(); });
+    }
+}
+
+void ConnectionManager::beginWrite() {
+    if (groupRows <= 1 || inTransaction || !writer) {
+        return;
+    }
+    char* errmsg = nullptr;
+    if (sqlite3_exec(writer->db, "BEGIN", nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+        return;
+    }
+    inTransaction = true;
+    pendingRows = 0;
+    batchStart = std::chrono::steady_clock::now();
+    flushCondition.notify_all();
+}
+
+void ConnectionManager::endWrite() {
+    if (inTransaction && ++pendingRows >= groupRows) {
+        commitBatch();
+    }
+}
+
+void ConnectionManager::beginBulkWrite() {
+    if (!writer) {
+        return;
+    }
+    if (inTransaction) {
+        commitBatch();
+    }
+    char* errmsg = nullptr;
+    if (sqlite3_exec(writer->db, "BEGIN", nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+    }
+}
+
+void ConnectionManager::endBulkWrite() {
+    if (!writer) {
+        return;
+    }
+    char* errmsg = nullptr;
+    if (sqlite3_exec(writer->db, "COMMIT", nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+    }
+}
+
+void ConnectionManager::flushWrites() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (inTransaction) {
+        commitBatch();
+    }
+}
+
+void ConnectionManager::commitBatch() {
+    char* errmsg = nullptr;
+    if (sqlite3_exec(writer->db, "COMMIT", nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+    }
+    // A failed COMMIT leaves the transaction open; it is retried with the next batch.
+    inTransaction = !sqlite3_get_autocommit(writer->db);
+    pendingRows = 0;
+}
+
+// Commits a batch once it has been open for groupDelay. Waiting on the
+// condition releases the writer mutex, so writers are never held up by it.
+void ConnectionManager::flushLoop() {
+    std::unique_lock<std::mutex> lock(writerMutex);
+    while (!stopping) {
+        if (!inTransaction) {
+            flushCondition.wait(lock);
+            continue;
+        }
+        auto deadline = batchStart + groupDelay;
+        if (flushCondition.wait_until(lock, deadline) == std::cv_status::timeout && inTransaction &&
+            std::chrono::steady_clock::now() >= deadline) {
+            commitBatch();
+        }
+    }
+}
+
+std::unique_ptr<DatabaseConnection> ConnectionManager::openReader() {
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Can't open read connection: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+    return std::make_unique<DatabaseConnection>(db);
+}
+
+// Never blocks: when every pooled connection is lent out a new one is opened,
+// and connections beyond maxIdleReaders are closed again when they come back.
+// A caller that holds a reader while acquiring another cannot deadlock.
+ReadConnection ConnectionManager::acquireReader() {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!idleReaders.empty()) {
+            std::unique_ptr<DatabaseConnection> reader = std::move(idleReaders.back());
+            idleReaders.pop_back();
+            return ReadConnection(this, std::move(reader));
+        }
+    }
+    return ReadConnection(this, writer ? openReader() : nullptr);
+}
+
+void ConnectionManager::release(std::unique_ptr<DatabaseConnection> connection) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (idleReaders.size() < maxIdleReaders) {
+        idleReaders.push_back(std::move(connection));
+    }
+}
+
+TableVersion ConnectionManager::getTableVersion(const std::string& table, int sensor) {
+    std::lock_guard<std::mutex> lock(versionMutex);
+    TableVersion result{0, startTime, 0, startTime, std::numeric_limits<std::int64_t>::min()};
+    auto it = tableVersions.find(table);
+    if (it != tableVersions.end()) {
+        result = it->second.version;
+        auto newest = it->second.newest.find(sensor);
+        result.newest = newest != it->second.newest.end() ? newest->second : std::numeric_limits<std::int64_t>::min();
+    }
+    return result;
+}
+
+void ConnectionManager::bumpVersion(const std::string& table, bool rewritesHistory) {
+    TableState& entry = tableVersions.emplace(table, TableState{TableVersion{0, startTime, 0, startTime, 0}, {}}).first->second;
+    ++entry.version.version;
+    entry.version.modified = std::time(nullptr);
+    if (rewritesHistory) {
+        ++entry.version.history;
+        entry.version.rewritten = entry.version.modified;
+    }
+}
+
+// Partitions (<table>__YYYYMMDD) and migration copies count as their parent table.
+static std::string parentTable(const char* table) {
+    std::string name(table);
+    return name.substr(0, name.find("__"));
+}
+
+// Changes bump the version straight away and again once the transaction is
+// committed to the WAL. A reader that saw the first bump but still read the
+// old snapshot therefore caches its result under a version that is already gone.
+void ConnectionManager::markChanged(const std::string& table) {
+    std::lock_guard<std::mutex> lock(versionMutex);
+    bumpVersion(table, true);
+    uncommittedTables[table] = true;
+}
+
+void ConnectionManager::markAppended(const std::string& table, int sensor, std::int64_t first, std::int64_t last) {
+    std::lock_guard<std::mutex> lock(versionMutex);
+    TableState& entry = tableVersions.emplace(table, TableState{TableVersion{0, startTime, 0, startTime, 0}, {}}).first->second;
+    auto newest = entry.newest.emplace(sensor, std::numeric_limits<std::int64_t>::min()).first;
+    bool rewritesHistory = first < newest->second;
+    newest->second = std::max(newest->second, last);
+    bumpVersion(table, rewritesHistory);
+    uncommittedTables[table] = uncommittedTables[table] || rewritesHistory;
+}
+
+void ConnectionManager::onUpdate(void* context, int, const char*, const char* table, sqlite3_int64) {
+    ConnectionManager* manager = static_cast<ConnectionManager*>(context);
+    std::lock_guard<std::mutex> lock(manager->versionMutex);
+    std::string parent = parentTable(table);
+    manager->bumpVersion(parent, true);
+    manager->uncommittedTables[parent] = true;
+}
+
+// Installing a WAL hook replaces SQLite's automatic checkpointing, so the
+// default threshold is applied here.
+int ConnectionManager::onWalCommit(void* context, sqlite3* db, const char* database, int pages) {
+    ConnectionManager* manager = static_cast<ConnectionManager*>(context);
+    {
+        std::lock_guard<std::mutex> lock(manager->versionMutex);
+        for (const auto& entry : manager->uncommittedTables) {
+            manager->bumpVersion(entry.first, entry.second);
+        }
+        manager->uncommittedTables.clear();
+    }
+
+    if (pages >= WAL_AUTOCHECKPOINT_PAGES) {
+        sqlite3_wal_checkpoint_v2(db, database, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+    }
+    return SQLITE_OK;
+}
@@ -0,0 +1,166 @@
+#ifndef CONNECTION_MANAGER_H
+#define CONNECTION_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <map>
+#include <set>
+#include <cstdint>
+#include <ctime>
+#include <sqlite3.h>
+#include "statement_cache.h"
+#include "sample_cursor.h"
+
+class ConnectionManager;
+
+// Write watermark of a table: version grows on every committed change and
+// modified holds the wall-clock time of the last one. history only grows with
+// changes that reach back before a sensor's newest sample (retention, late or
+// replaced samples), so a range ending before newest stays valid until it does.
+struct TableVersion {
+    std::uint64_t version;
+    std::time_t modified;
+    std::uint64_t history;
+    std::time_t rewritten;
+    std::int64_t newest;
+};
+
+// Version of a table together with the newest sample appended per sensor.
+struct TableState {
+    TableVersion version;
+    std::map<int, std::int64_t> newest;
+};
+
+// An open handle together with the statements prepared on it.
+struct DatabaseConnection {
+    sqlite3* db;
+    StatementCache statements;
+
+    explicit DatabaseConnection(sqlite3* db) : db(db), statements(db) {}
+    ~DatabaseConnection() { sqlite3_close_v2(db); }
+};
+
+// A read-only connection borrowed from the pool; returned to it on destruction.
+class ReadConnection {
+private:
+    ConnectionManager* manager;
+    std::unique_ptr<DatabaseConnection> connection;
+
+public:
+    ReadConnection(ConnectionManager* manager, std::unique_ptr<DatabaseConnection> connection);
+    ReadConnection(ReadConnection&& other) noexcept;
+    ReadConnection(const ReadConnection&) = delete;
+    ReadConnection& operator=(const ReadConnection&) = delete;
+    ReadConnection& operator=(ReadConnection&&) = delete;
+    ~ReadConnection();
+
+    sqlite3* get() const { return connection ? connection->db : nullptr; }
+    StatementCache& statements() { return connection->statements; }
+};
+
+// The (epoch, temperature) rows of a bound range statement. The cursor keeps
+// its pooled read connection, and the statement's WAL snapshot, until it is
+// destroyed.
+class StatementCursor : public SampleCursor {
+private:
+    ReadConnection reader;
+    CachedStatement statement;
+
+public:
+    StatementCursor(ReadConnection reader, CachedStatement statement) :
+        reader(std::move(reader)), statement(std::move(statement)) {}
+
+    bool next(Sample& sample) override {
+        if (sqlite3_step(statement.get()) != SQLITE_ROW) {
+            return false;
+        }
+        sample = Sample{sqlite3_column_int64(statement.get(), 0), sqlite3_column_double(statement.get(), 1)};
+        return true;
+    }
+};
+
+// Owns every SQLite handle of the process. The database runs in WAL mode so
+// readers never block the writer: one read-write connection takes all inserts
+// and deletes (callers serialise on it with getWriterMutex()), and read-only
+// connections are handed out from a pool so queries run in parallel.
+//
+// Writes are wrapped in beginWrite()/endWrite(). With group commit enabled
+// they share one transaction that is committed after maxRows writes or once
+// it has been open for maxDelay, whichever comes first, so one WAL sync
+// covers a whole batch. maxDelay is the durability window: a crash loses at
+// most the writes of that last interval, and readers see new rows that much
+// later.
+class ConnectionManager {
+private:
+    std::string path;
+    std::unique_ptr<DatabaseConnection> writer;
+    std::mutex writerMutex;
+    std::vector<std::unique_ptr<DatabaseConnection>> idleReaders;
+    std::mutex poolMutex;
+    size_t maxIdleReaders;
+
+    std::map<std::string, TableState> tableVersions;
+    // Tables written in the open transaction; true if the change rewrote history.
+    std::map<std::string, bool> uncommittedTables;
+    std::mutex versionMutex;
+    std::time_t startTime;
+
+    size_t groupRows;
+    std::chrono::milliseconds groupDelay;
+    size_t pendingRows;
+    bool inTransaction;
+    std::chrono::steady_clock::time_point batchStart;
+    std::condition_variable flushCondition;
+    std::thread flusher;
+    bool stopping;
+
+    std::unique_ptr<DatabaseConnection> openReader();
+    void release(std::unique_ptr<DatabaseConnection> connection);
+    void bumpVersion(const std::string& table, bool rewritesHistory);
+    void commitBatch();
+    void flushLoop();
+
+    static void onUpdate(void* context, int operation, const char* database, const char* table, sqlite3_int64 rowid);
+    static int onWalCommit(void* context, sqlite3* db, const char* database, int pages);
+
+    friend class ReadConnection;
+
+public:
+    explicit ConnectionManager(const std::string& path);
+    ~ConnectionManager();
+
+    sqlite3* getWriter() const { return writer ? writer->db : nullptr; }
+    // Statements of the writer connection; guarded by the same mutex as the writer.
+    StatementCache& getWriterStatements() { return writer->statements; }
+    std::mutex& getWriterMutex() { return writerMutex; }
+
+    // maxRows <= 1 turns group commit off: every write commits on its own.
+    void setGroupCommit(size_t maxRows, std::chrono::milliseconds maxDelay);
+    // Called with the writer mutex held around each write statement.
+    void beginWrite();
+    void endWrite();
+    // One explicit transaction around many writes, regardless of group commit.
+    // Also called with the writer mutex held; an open batch is committed first.
+    void beginBulkWrite();
+    void endBulkWrite();
+    // Commits the open batch, if any. Takes the writer mutex.
+    void flushWrites();
+    ReadConnection acquireReader();
+    // newest is the sensor's newest appended sample, or INT64_MIN if none was
+    // appended since startup.
+    TableVersion getTableVersion(const std::string& table, int sensor);
+    // Records removed rows or a dropped table. The update hook does not see
+    // WITHOUT ROWID tables, so writers report their changes themselves.
+    void markChanged(const std::string& table);
+    // Records samples of one sensor with epochs in [first, last].
+    void markAppended(const std::string& table, int sensor, std::int64_t first, std::int64_t last);
+};
+
+ConnectionManager& getConnectionManager();
+
+#endif
@@ -1,4 +1,7 @@
 #include "data_aggregator.h"
+#include "schema.h"
+#include "sqlite_backend.h"
+#include "timestamp.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -7,57 +10,67 @@
 #include <numeric>
 #include <sstream>
 #include <random>
+#include <limits>
+#include <cstdio>
+#include <filesystem>
+#include <algorithm>
 
-sqlite3*& getDatabase() {
-    static sqlite3* db = nullptr;
-    static std::once_flag once;
+#define DAY_SECONDS (24 * 60 * 60)
 
-    std::call_once(once, []() {
-        const char* dbPath = "logs.db";
-        int rc = sqlite3_open(dbPath, &db);
-        if (rc != SQLITE_OK) {
-            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
-            getDatabase();
-        }
-    });
-
-    return db;
+static std::int64_t floorMod(std::int64_t value, std::int64_t divisor) {
+    return ((value % divisor) + divisor) % divisor;
 }
 
-std::string DataAggregator::getCurrentTimestamp(TimeResolution res) {
-    auto now = std::chrono::system_clock::now();
-    auto in_time_t = std::chrono::system_clock::to_time_t(now);
-    std::tm *tm_time = std::localtime(&in_time_t);
-
-    if (res == TimeResolution::HOUR) {
-        tm_time->tm_min = 0;
-        tm_time->tm_sec = 0;
-    } else if (res == TimeResolution::DAY) {
-        tm_time->tm_hour = 0;
-        tm_time->tm_min = 0;
-        tm_time->tm_sec = 0;
+std::int64_t bucketStart(std::int64_t epoch, TimeResolution resolution) {
+    std::int64_t local = epochToLocal(epoch);
+    switch (resolution) {
+        case TimeResolution::HOUR:
+            return epoch - floorMod(local, 3600);
+        case TimeResolution::DAY:
+            return localToEpoch(local - floorMod(local, DAY_SECONDS));
+        case TimeResolution::CURRENT:
+            break;
     }
+    return epoch;
+}
 
-    std::stringstream ss;
-    ss << std::put_time(tm_time, "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+std::int64_t nextBucketStart(std::int64_t start, TimeResolution resolution) {
+    switch (resolution) {
+        case TimeResolution::HOUR:
+            return start + 3600;
+        case TimeResolution::DAY:
+            return localToEpoch(epochToLocal(start) + DAY_SECONDS);
+        case TimeResolution::CURRENT:
+            break;
+    }
+    return start + 1;
 }
 
+// An hour of data_current, a day of the rollups: whole UTC hours and days
+// nest in the backends' day and month partitions and segments. A memory
+// backend starts out empty, so its summaries are not saved.
+static std::int64_t sliceSeconds(TimeResolution resolution) {
+    return resolution == TimeResolution::CURRENT ? 3600 : DAY_SECONDS;
+}
 
-DataAggregator::DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex) :
-    filename(filename), resolution(res), fileMutex(mutex), db(getDatabase()), timeThreshold(std::chrono::hours(0)) {
+std::string DataAggregator::getCurrentTimestamp(TimeResolution res) {
+    return formatLocalTimestamp(bucketStart(static_cast<std::int64_t>(std::time(nullptr)), res));
+}
 
-    std::stringstream ss;
-    ss << "CREATE TABLE IF NOT EXISTS \"" << filename << "\" (timestamp TEXT PRIMARY KEY, temperature REAL)";
-    std::string create_table_sql = ss.str();
-    const char* sql_cstr = create_table_sql.c_str();
 
-    char* errmsg = nullptr;
-    int rc = sqlite3_exec(db, sql_cstr, nullptr, nullptr, &errmsg);
+DataAggregator::DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex, PartitionScheme scheme,
+                               StorageEngine engine) :
+    filename(filename), resolution(res), fileMutex(mutex), connections(getConnectionManager()), engine(engine),
+    backend(makeStorageBackend(engine, filename, connections, scheme)), timeThreshold(std::chrono::hours(0)),
+    summaries(*backend, sliceSeconds(res),
+              engine == StorageEngine::MEMORY ? "" : filename + "." + storageEngineName(engine) + ".summary") {
 
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL error: " << errmsg << std::endl;
-        sqlite3_free(errmsg);
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        if (!backend->open()) {
+            std::cerr << "Can't open " << storageEngineName(engine) << " storage for " << filename << std::endl;
+        }
+        summaries.load();
     }
     switch (resolution) {
         case TimeResolution::DAY:
@@ -73,192 +86,155 @@ DataAggregator::DataAggregator(const std::string& filename, TimeResolution res,
 }
 
 
-void DataAggregator::addTemperature(float temperature, const std::string& timestamp) {
-    std::lock_guard<std::mutex> lock(fileMutex);
-    if (!db) return;
-
-    std::stringstream ss;
-    std::string timestampToInsert;
-
-    if (timestamp.empty()) {
-        auto now = std::chrono::system_clock::now();
-        auto time_t_now = std::chrono::system_clock::to_time_t(now);
-        std::tm tm_time = *std::localtime(&time_t_now);
+void DataAggregator::enableHotTier(size_t capacity, const std::vector<int>& sensors) {
+    std::int64_t window = static_cast<std::int64_t>(timeThreshold.count());
+    std::int64_t from = static_cast<std::int64_t>(std::time(nullptr)) - window;
+    for (int sensor : sensors) {
+        std::vector<Sample> samples;
+        std::unique_ptr<SampleCursor> cursor = backend->scan(sensor, from, std::numeric_limits<std::int64_t>::max());
+        for (Sample sample; cursor->next(sample);) {
+            samples.push_back(sample);
+        }
+        cursor.reset();
 
-        std::stringstream ss_time;
-        ss_time << std::put_time(&tm_time, "%Y-%m-%d %H:%M:%S");
-        timestampToInsert = ss_time.str();
-    } else {
-        timestampToInsert = timestamp;
+        std::lock_guard<std::mutex> lock(fileMutex);
+        std::unique_ptr<HotTier>& tier = hotTiers[sensor];
+        tier = std::make_unique<HotTier>(capacity, window);
+        tier->load(samples, from);
     }
+}
 
-    ss << "INSERT OR REPLACE INTO \"" << filename << "\" (timestamp, temperature) VALUES (?, ?)";
 
-    std::string sql = ss.str();
-    const char* sql_cstr = sql.c_str();
+const HotTier* DataAggregator::getHotTier(int sensor) const {
+    auto it = hotTiers.find(sensor);
+    return it != hotTiers.end() ? it->second.get() : nullptr;
+}
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, sql_cstr, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
-        return;
-    }
 
-    sqlite3_bind_text(stmt, 1, timestampToInsert.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_double(stmt, 2, temperature);
+// The append-only engines first decide whether they keep the sample; the
+// tier, the summary and the table version follow what the backend took.
+void DataAggregator::addTemperature(int sensor, float temperature, const std::chrono::system_clock::time_point& time) {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    Sample sample{static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(time)), temperature};
+    auto hot = hotTiers.find(sensor);
+    HotTier* tier = hot != hotTiers.end() ? hot->second.get() : nullptr;
 
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE && rc != SQLITE_OK && rc != SQLITE_ROW) {
-        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+    if (backend->append(sensor, sample)) {
+        if (tier) {
+            tier->append(sample.epoch, temperature);
+        }
+        summaries.add(sensor, sample);
+        if (engine != StorageEngine::SQLITE) {
+            backend->flush();
+        }
+        connections.markAppended(filename, sensor, sample.epoch, sample.epoch);
     }
-
-    sqlite3_finalize(stmt);
 }
 
 
-DataAggregator::~DataAggregator() {}
-
-
-float DataAggregator::getAverageTemperature(const std::chrono::system_clock::time_point& startTime, const std::chrono::system_clock::time_point& endTime) {
+void DataAggregator::addTemperatures(int sensor, const std::vector<Sample>& samples) {
     std::lock_guard<std::mutex> lock(fileMutex);
-    if (!db) return 0.0f;
-
-    std::stringstream ss;
-    ss << "SELECT AVG(temperature) FROM \"" << filename << "\" WHERE timestamp BETWEEN ? AND ?"; // placeholders ?
-
-    std::string sql = ss.str();
-    const char* sql_cstr = sql.c_str();
-
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, sql_cstr, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
-        return 0.0f;
+    if (samples.empty()) return;
+
+    // The tier and the summary get the samples an append-only engine is going
+    // to keep: those newer than the sensor's last one and than each other.
+    const SeriesSummary& summary = summaries.get(sensor);
+    auto hot = hotTiers.find(sensor);
+    HotTier* tier = hot != hotTiers.end() ? hot->second.get() : nullptr;
+    std::int64_t newest = summary.count > 0 ? summary.last : std::numeric_limits<std::int64_t>::min();
+    std::int64_t first = std::numeric_limits<std::int64_t>::max(), last = std::numeric_limits<std::int64_t>::min();
+    for (const Sample& sample : samples) {
+        first = std::min(first, sample.epoch);
+        last = std::max(last, sample.epoch);
+        if (backend->replacesSamples() || sample.epoch > newest) {
+            if (tier) {
+                tier->append(sample.epoch, static_cast<float>(sample.temperature));
+            }
+            summaries.add(sensor, sample);
+            newest = sample.epoch;
+        }
     }
-
-    auto formatTime = [](const std::chrono::system_clock::time_point& time) {
-        auto time_t_time = std::chrono::system_clock::to_time_t(time);
-        std::tm tm_time = *std::localtime(&time_t_time);
-        std::stringstream ss_time;
-        ss_time << std::put_time(&tm_time, "%Y-%m-%d %H:%M:%S");
-        return ss_time.str();
-    };
-
-    std::string startTimeStr = formatTime(startTime);
-    std::string endTimeStr = formatTime(endTime);
-
-    sqlite3_bind_text(stmt, 1, startTimeStr.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, endTimeStr.c_str(), -1, SQLITE_TRANSIENT);
-
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW) {
-        float avgTemp = static_cast<float>(sqlite3_column_double(stmt, 0));
-        sqlite3_finalize(stmt);
-        return avgTemp;
-    } else if (rc != SQLITE_DONE) {
-        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+    if (backend->appendBatch(sensor, samples) > 0) {
+        connections.markAppended(filename, sensor, first, last);
     }
-
-    sqlite3_finalize(stmt);
-    return 0.0f;
 }
 
 
-std::chrono::system_clock::time_point DataAggregator::getFirstDate() {
+DataAggregator::~DataAggregator() {
     std::lock_guard<std::mutex> lock(fileMutex);
-    if (!db) return std::chrono::system_clock::now();
+    summaries.save();
+}
 
-    std::stringstream ss;
-    ss << "SELECT MIN(timestamp) FROM \"" << filename << "\"";
 
-    std::string sql = ss.str();
-    const char* sql_cstr = sql.c_str();
+float DataAggregator::getAverageTemperature(int sensor, const std::chrono::system_clock::time_point& startTime,
+                                            const std::chrono::system_clock::time_point& endTime) {
+    Bucket summary = getSummary(sensor, startTime, endTime);
+    return summary.count > 0 ? static_cast<float>(summary.sum / summary.count) : 0.0f;
+}
+
+
+Bucket DataAggregator::getSummary(int sensor, const std::chrono::system_clock::time_point& startTime,
+                                  const std::chrono::system_clock::time_point& endTime) {
+    return backend->summarize(sensor, static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(startTime)),
+                              static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(endTime)));
+}
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, sql_cstr, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
-        return std::chrono::system_clock::now();
-    }
 
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW) {
-        const char* timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        if (timestamp) {
-        std::tm t{};
-        std::istringstream ss_ts(timestamp);
-        ss_ts >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-
-        if (!ss_ts.fail()) {
-            std::time_t epochTime = mktime(&t);
-            if (epochTime != -1) {
-            return std::chrono::system_clock::from_time_t(epochTime);
-            } else {
-            std::cerr << "mktime failed\n";
+// Buckets are cut while the samples stream past in epoch order; local time is
+// only consulted when a sample crosses into the next bucket.
+std::vector<Sample> DataAggregator::getBucketAverages(int sensor, const std::chrono::system_clock::time_point& startTime,
+                                                      const std::chrono::system_clock::time_point& endTime, TimeResolution res) {
+    std::vector<Sample> buckets;
+    std::unique_ptr<SampleCursor> cursor =
+        backend->scan(sensor, static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(startTime)),
+                      static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(endTime)) - 1);
+
+    std::int64_t currentStart = 0, currentEnd = 0, count = 0;
+    double sum = 0.0;
+    for (Sample sample; cursor->next(sample);) {
+        if (count == 0 || sample.epoch >= currentEnd) {
+            if (count > 0) {
+                buckets.push_back(Sample{currentStart, sum / count});
             }
-        } else {
-            std::cerr << "Parsing date failed from SQLite result\n";
-        }
+            currentStart = bucketStart(sample.epoch, res);
+            currentEnd = nextBucketStart(currentStart, res);
+            sum = 0.0;
+            count = 0;
         }
-    } else if (rc == SQLITE_DONE) {
-        std::cerr << "No records found in database\n";
-        return std::chrono::system_clock::now();
-    } else {
-        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+        sum += sample.temperature;
+        ++count;
     }
-
-    sqlite3_finalize(stmt);
-    return std::chrono::system_clock::now();
+    if (count > 0) {
+        buckets.push_back(Sample{currentStart, sum / count});
+    }
+    return buckets;
 }
 
 
-std::chrono::system_clock::time_point DataAggregator::getLastDate() {
+std::chrono::system_clock::time_point DataAggregator::getFirstDate(int sensor) {
     std::lock_guard<std::mutex> lock(fileMutex);
-    if (!db) {
-        return getDefaultTime();
+    const SeriesSummary& summary = summaries.get(sensor);
+    if (summary.count == 0) {
+        std::cerr << "No records found in database\n";
+        return std::chrono::system_clock::now();
     }
+    return std::chrono::system_clock::from_time_t(static_cast<std::time_t>(summary.first));
+}
 
-    std::stringstream ss;
-    ss << "SELECT MAX(timestamp) FROM \"" << filename << "\"";
-    std::string sql = ss.str();
-    const char* sql_cstr = sql.c_str();
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, sql_cstr, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+std::chrono::system_clock::time_point DataAggregator::getLastDate(int sensor) {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    const SeriesSummary& summary = summaries.get(sensor);
+    if (summary.count == 0) {
         return getDefaultTime();
     }
+    return std::chrono::system_clock::from_time_t(static_cast<std::time_t>(summary.last));
+}
 
-    rc = sqlite3_step(stmt);
-    std::chrono::system_clock::time_point result = std::chrono::system_clock::time_point::min();
-
-    if (rc == SQLITE_ROW) {
-        const char* timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        if (timestamp) {
-            std::tm t{};
-            std::istringstream ss_ts(timestamp);
-            ss_ts >> std::get_time(&t, "%Y-%m-%d %H:%M:%S");
-
-            if (!ss_ts.fail()) {
-                std::time_t epochTime = mktime(&t);
-                if (epochTime != -1) {
-                    result = std::chrono::system_clock::from_time_t(epochTime);
-                    sqlite3_finalize(stmt);
-                    return result;
-                } else {
-                    std::cerr << "mktime failed\n";
-                }
-            } else {
-                std::cerr << "Parsing date failed from SQLite result\n";
-            }
-        }
-    } else if (rc != SQLITE_DONE && rc != SQLITE_OK && rc != SQLITE_ROW) {
-        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
-    }
 
-    sqlite3_finalize(stmt);
-    return getDefaultTime();
+SeriesSummary DataAggregator::getSeriesSummary(int sensor) {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    return summaries.get(sensor);
 }
 
 std::chrono::system_clock::time_point DataAggregator::getDefaultTime() const {
@@ -273,38 +249,15 @@ std::chrono::system_clock::time_point DataAggregator::getDefaultTime() const {
 
 void DataAggregator::removeOutdated() {
     std::lock_guard<std::mutex> lock(fileMutex);
-    if (!db) return;
-
-    std::stringstream ss;
-    ss << "DELETE FROM \"" << filename << "\" WHERE timestamp < datetime('now', '-";
-
-    switch (resolution) {
-        case TimeResolution::DAY:
-            ss << "1 year')";
-            break;
-        case TimeResolution::HOUR:
-            ss << "1 month')";
-            break;
-        case TimeResolution::CURRENT:
-            ss << "1 day')";
-            break;
-    }
-
-    std::string sql = ss.str();
-    const char* sql_cstr = sql.c_str();
-
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db, sql_cstr, -1, &stmt, nullptr);
-
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
-        return;
+    std::int64_t cutoff = static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() - timeThreshold));
+    // Everything before a slice start, moved back to where the backend's own
+    // day or partition starts, so the slices before it are exactly what goes.
+    cutoff = backend->dropBoundary(cutoff - floorMod(cutoff, sliceSeconds(resolution)));
+
+    size_t dropped = backend->dropBefore(cutoff);
+    if (dropped > 0 && engine != StorageEngine::SQLITE) {
+        connections.markChanged(filename);
     }
-
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
-        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
-    }
-
-    sqlite3_finalize(stmt);
-}
\ No newline at end of file
+    summaries.dropBefore(cutoff);
+    summaries.save();
+}
@@ -4,7 +4,15 @@
 #include <string>
 #include <chrono>
 #include <mutex>
-#include <sqlite3.h>
+#include <vector>
+#include <memory>
+#include <map>
+#include "connection_manager.h"
+#include "response_format.h"
+#include "storage_backend.h"
+#include "summary_store.h"
+#include "partitions.h"
+#include "hot_tier.h"
 
 enum class TimeResolution {
     DAY,
@@ -12,29 +20,66 @@ enum class TimeResolution {
     CURRENT
 };
 
-sqlite3*& getDatabase();
+// Start of the local hour or day containing epoch, and the start of the next one.
+std::int64_t bucketStart(std::int64_t epoch, TimeResolution resolution);
+std::int64_t nextBucketStart(std::int64_t start, TimeResolution resolution);
 
 class DataAggregator {
 private:
     std::string filename;
     TimeResolution resolution;
     std::mutex& fileMutex;
-    sqlite3* db; 
+    ConnectionManager& connections;
+    StorageEngine engine;
+    std::unique_ptr<StorageBackend> backend;
     std::chrono::seconds timeThreshold;
+    std::map<int, std::unique_ptr<HotTier>> hotTiers;
+    SummaryStore summaries;
 
     std::string getCurrentTimestamp(TimeResolution res);
     std::chrono::system_clock::time_point getDefaultTime() const;
 
 public:
-    DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex);
+    // The samples are kept by the engine's backend for filename. With SQLite
+    // and a partition scheme, filename becomes a view over time partitions and
+    // removeOutdated() drops whole partitions instead of deleting rows.
+    DataAggregator(const std::string& filename, TimeResolution res, std::mutex& mutex,
+                   PartitionScheme scheme = PartitionScheme::NONE, StorageEngine engine = StorageEngine::SQLITE);
 
-    void addTemperature(float temperature, const std::string& timestamp = "");
+    // Keeps the retention window of each of these sensors in memory as well,
+    // loading it from the table now. Call before the aggregator is shared.
+    void enableHotTier(size_t capacity, const std::vector<int>& sensors);
+    // Null when the sensor has no hot tier.
+    const HotTier* getHotTier(int sensor) const;
+    StorageEngine getStorageEngine() const { return engine; }
+    const StorageBackend& getBackend() const { return *backend; }
 
-    float getAverageTemperature(const std::chrono::system_clock::time_point& startTime, const std::chrono::system_clock::time_point& endTime);
+    void addTemperature(int sensor, float temperature,
+                        const std::chrono::system_clock::time_point& time = std::chrono::system_clock::now());
+    // Stores all samples in a single transaction.
+    void addTemperatures(int sensor, const std::vector<Sample>& samples);
 
-    std::chrono::system_clock::time_point getFirstDate();
-    std::chrono::system_clock::time_point getLastDate();
+    float getAverageTemperature(int sensor, const std::chrono::system_clock::time_point& startTime,
+                                const std::chrono::system_clock::time_point& endTime);
 
+    // Count, sum, min and max of the samples in [startTime, endTime); the
+    // bucket's epoch is startTime.
+    Bucket getSummary(int sensor, const std::chrono::system_clock::time_point& startTime,
+                      const std::chrono::system_clock::time_point& endTime);
+
+    // Average of every local hour or day in [startTime, endTime) that has
+    // samples, from one grouped scan. The sample's epoch is the bucket start.
+    std::vector<Sample> getBucketAverages(int sensor, const std::chrono::system_clock::time_point& startTime,
+                                          const std::chrono::system_clock::time_point& endTime, TimeResolution res);
+
+    // Served from a SummaryStore with a slice per hour of data_current and
+    // per day of the rollups, saved to "<filename>.<engine>.summary".
+    std::chrono::system_clock::time_point getFirstDate(int sensor);
+    std::chrono::system_clock::time_point getLastDate(int sensor);
+    SeriesSummary getSeriesSummary(int sensor);
+
+    // Applies the retention period to every sensor. The cut is made at the
+    // start of a slice, so up to one slice more than the period is kept.
     void removeOutdated();
     
     ~DataAggregator();
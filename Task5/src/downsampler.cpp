@@ -0,0 +1,127 @@
+#include "downsampler.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+bool parseDownsampleMethod(const std::string& value, DownsampleMethod& method) {
+    if (value.empty() || value == "lttb") {
+        method = DownsampleMethod::LTTB;
+    } else if (value == "minmax") {
+        method = DownsampleMethod::MIN_MAX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Downsampler::Downsampler(DownsampleMethod method, std::int64_t firstEpoch, std::int64_t lastEpoch, size_t points) :
+    method(method), firstEpoch(firstEpoch), span(std::max<std::int64_t>(1, lastEpoch - firstEpoch + 1)),
+    started(false), previous{0, 0.0}, last{0, 0.0}, currentBucket(-1), nextBucket(-1), minSample{0, 0.0}, maxSample{0, 0.0} {
+
+    std::int64_t count = static_cast<std::int64_t>(points);
+    buckets = method == DownsampleMethod::MIN_MAX ? count / 2 : count - 1;
+    buckets = std::max<std::int64_t>(1, buckets);
+}
+
+std::int64_t Downsampler::bucketOf(std::int64_t epoch) const {
+    std::int64_t offset = std::min(std::max<std::int64_t>(0, epoch - firstEpoch), span - 1);
+    return offset * buckets / span;
+}
+
+void Downsampler::flushMinMax(std::vector<Sample>& output) {
+    if (currentBucket < 0) {
+        return;
+    }
+    if (minSample.epoch == maxSample.epoch) {
+        output.push_back(minSample);
+    } else if (minSample.epoch < maxSample.epoch) {
+        output.push_back(minSample);
+        output.push_back(maxSample);
+    } else {
+        output.push_back(maxSample);
+        output.push_back(minSample);
+    }
+}
+
+void Downsampler::selectFromCurrent(std::vector<Sample>& output) {
+    double nextEpoch = 0.0;
+    double nextTemperature = 0.0;
+    for (const Sample& sample : next) {
+        nextEpoch += static_cast<double>(sample.epoch);
+        nextTemperature += sample.temperature;
+    }
+    nextEpoch /= next.size();
+    nextTemperature /= next.size();
+
+    const Sample* best = &current.front();
+    double bestArea = -1.0;
+    for (const Sample& sample : current) {
+        double area = std::fabs((previous.epoch - nextEpoch) * (sample.temperature - previous.temperature) -
+                                (previous.epoch - static_cast<double>(sample.epoch)) * (nextTemperature - previous.temperature));
+        if (area > bestArea) {
+            bestArea = area;
+            best = &sample;
+        }
+    }
+
+    output.push_back(*best);
+    previous = *best;
+}
+
+void Downsampler::add(const Sample& sample, std::vector<Sample>& output) {
+    std::int64_t bucket = bucketOf(sample.epoch);
+
+    if (method == DownsampleMethod::MIN_MAX) {
+        if (bucket != currentBucket) {
+            flushMinMax(output);
+            currentBucket = bucket;
+            minSample = sample;
+            maxSample = sample;
+        } else {
+            if (sample.temperature < minSample.temperature) minSample = sample;
+            if (sample.temperature > maxSample.temperature) maxSample = sample;
+        }
+        return;
+    }
+
+    if (!started) {
+        started = true;
+        previous = sample;
+        last = sample;
+        output.push_back(sample);
+        return;
+    }
+    last = sample;
+
+    if (current.empty() || bucket == currentBucket) {
+        currentBucket = bucket;
+        current.push_back(sample);
+    } else if (next.empty() || bucket == nextBucket) {
+        nextBucket = bucket;
+        next.push_back(sample);
+    } else {
+        selectFromCurrent(output);
+        current.swap(next);
+        currentBucket = nextBucket;
+        next.clear();
+        nextBucket = bucket;
+        next.push_back(sample);
+    }
+}
+
+void Downsampler::finish(std::vector<Sample>& output) {
+    if (method == DownsampleMethod::MIN_MAX) {
+        flushMinMax(output);
+        currentBucket = -1;
+        return;
+    }
+
+    if (!current.empty() && !next.empty()) {
+        selectFromCurrent(output);
+    }
+    if (!current.empty()) {
+        output.push_back(last);
+    }
+    current.clear();
+    next.clear();
+}
@@ -0,0 +1,53 @@
+#ifndef DOWNSAMPLER_H
+#define DOWNSAMPLER_H
+
+#include <cstdint>
+#include <vector>
+#include "response_format.h"
+
+enum class DownsampleMethod {
+    LTTB,
+    MIN_MAX
+};
+
+// Reduces a time-ordered sample stream to roughly `points` samples while it is
+// being read. The time span [firstEpoch, lastEpoch] is cut into equal buckets:
+//   MIN_MAX - emits the lowest and highest sample of every bucket, in time order;
+//   LTTB    - Largest-Triangle-Three-Buckets: keeps the first and last sample and
+//             from every other bucket the one forming the largest triangle with
+//             the previously kept sample and the average of the next bucket.
+// At most two buckets are held in memory, so a range of any size costs
+// O(samples per bucket).
+class Downsampler {
+private:
+    DownsampleMethod method;
+    std::int64_t firstEpoch;
+    std::int64_t span;
+    std::int64_t buckets;
+
+    bool started;
+    Sample previous;
+    Sample last;
+
+    std::int64_t currentBucket;
+    std::vector<Sample> current;
+    std::int64_t nextBucket;
+    std::vector<Sample> next;
+
+    Sample minSample;
+    Sample maxSample;
+
+    std::int64_t bucketOf(std::int64_t epoch) const;
+    void flushMinMax(std::vector<Sample>& output);
+    void selectFromCurrent(std::vector<Sample>& output);
+
+public:
+    Downsampler(DownsampleMethod method, std::int64_t firstEpoch, std::int64_t lastEpoch, size_t points);
+
+    void add(const Sample& sample, std::vector<Sample>& output);
+    void finish(std::vector<Sample>& output);
+};
+
+bool parseDownsampleMethod(const std::string& value, DownsampleMethod& method);
+
+#endif
@@ -0,0 +1,137 @@
+#include "hot_tier.h"
+#include <limits>
+#include <mutex>
+
+HotTier::HotTier(size_t capacity, std::int64_t window) :
+    epochs(capacity), temperatures(capacity), head(0), count(0), window(window),
+    covered(std::numeric_limits<std::int64_t>::max()) {}
+
+size_t HotTier::lowerBound(std::int64_t epoch) const {
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (epochs[slot(middle)] < epoch) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void HotTier::evictOldest() {
+    covered = epochs[head] + 1;
+    head = (head + 1) % epochs.size();
+    --count;
+}
+
+void HotTier::load(const std::vector<Sample>& samples, std::int64_t from) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    head = 0;
+    count = 0;
+    covered = from;
+    for (const Sample& sample : samples) {
+        if (count == epochs.size()) {
+            evictOldest();
+        }
+        epochs[slot(count)] = sample.epoch;
+        temperatures[slot(count)] = static_cast<float>(sample.temperature);
+        ++count;
+    }
+}
+
+void HotTier::append(std::int64_t epoch, float temperature) {
+    if (epochs.empty()) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (count > 0) {
+        std::int64_t newest = epochs[slot(count - 1)];
+        if (epoch == newest) {
+            temperatures[slot(count - 1)] = temperature;
+            return;
+        }
+        if (epoch < newest) {
+            insertLate(epoch, temperature);
+            return;
+        }
+    } else if (covered == std::numeric_limits<std::int64_t>::max()) {
+        covered = epoch;
+    }
+
+    if (count == epochs.size()) {
+        evictOldest();
+    }
+    epochs[slot(count)] = epoch;
+    temperatures[slot(count)] = temperature;
+    ++count;
+
+    while (count > 1 && epochs[head] <= epoch - window) {
+        evictOldest();
+    }
+}
+
+// Shifts the newer samples one slot up. Late samples are rare, so the copy is
+// cheaper than giving up the contiguous layout the range scans rely on.
+void HotTier::insertLate(std::int64_t epoch, float temperature) {
+    if (epoch < covered) {
+        return;
+    }
+    size_t index = lowerBound(epoch);
+    if (index < count && epochs[slot(index)] == epoch) {
+        temperatures[slot(index)] = temperature;
+        return;
+    }
+    if (count == epochs.size()) {
+        evictOldest();
+        if (index == 0) {
+            return;
+        }
+        --index;
+    }
+    for (size_t position = count; position > index; --position) {
+        epochs[slot(position)] = epochs[slot(position - 1)];
+        temperatures[slot(position)] = temperatures[slot(position - 1)];
+    }
+    epochs[slot(index)] = epoch;
+    temperatures[slot(index)] = temperature;
+    ++count;
+}
+
+std::int64_t HotTier::coveredFrom() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return covered;
+}
+
+size_t HotTier::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return count;
+}
+
+bool HotTier::latest(Sample& sample) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (count == 0) {
+        return false;
+    }
+    size_t newest = slot(count - 1);
+    sample = Sample{epochs[newest], temperatures[newest]};
+    return true;
+}
+
+bool HotTier::range(std::int64_t start, std::int64_t end, std::vector<Sample>& output) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (start < covered) {
+        return false;
+    }
+    size_t first = lowerBound(start);
+    size_t last = first;
+    while (last < count && epochs[slot(last)] <= end) {
+        ++last;
+    }
+    output.reserve(output.size() + (last - first));
+    for (size_t index = first; index < last; ++index) {
+        size_t position = slot(index);
+        output.push_back(Sample{epochs[position], temperatures[position]});
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef HOT_TIER_H
+#define HOT_TIER_H
+
+#include <cstdint>
+#include <vector>
+#include <shared_mutex>
+#include "response_format.h"
+
+// In-memory copy of the newest samples of one table, kept as two parallel
+// ring buffers (epochs and temperatures) so a range scan walks contiguous
+// memory. The tier holds every sample with epoch >= coveredFrom() in epoch
+// order, up to `capacity` samples and at most `window` seconds behind the
+// newest one. Queries starting before coveredFrom() belong to SQLite.
+//
+// Readers take a shared lock only for as long as it takes to copy samples
+// out, so they never wait for the SQLite writer and the writer only waits
+// for those copies.
+class HotTier {
+private:
+    std::vector<std::int64_t> epochs;
+    std::vector<float> temperatures;
+    size_t head;
+    size_t count;
+    std::int64_t window;
+    std::int64_t covered;
+    mutable std::shared_mutex mutex;
+
+    size_t slot(size_t index) const { return (head + index) % epochs.size(); }
+    size_t lowerBound(std::int64_t epoch) const;
+    void evictOldest();
+    void insertLate(std::int64_t epoch, float temperature);
+
+public:
+    HotTier(size_t capacity, std::int64_t window);
+
+    // Replaces the contents with samples, which must be in epoch order and
+    // include every stored sample with epoch >= from.
+    void load(const std::vector<Sample>& samples, std::int64_t from);
+    // A sample older than the newest one is inserted in order, or ignored if
+    // it is older than coveredFrom() and so belongs to SQLite.
+    void append(std::int64_t epoch, float temperature);
+
+    std::int64_t coveredFrom() const;
+    size_t size() const;
+    // False when the tier is empty.
+    bool latest(Sample& sample) const;
+    // Appends the samples in [start, end] to output. Returns false, leaving
+    // output untouched, when samples before start may be missing.
+    bool range(std::int64_t start, std::int64_t end, std::vector<Sample>& output) const;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "ingest_queue.h"
+#include <thread>
+
+IngestQueue::IngestQueue(size_t capacity, OverflowPolicy policy) :
+    mask(0), policy(policy), enqueuePos(0), dequeuePos(0), pushed(0), popped(0), droppedOldest(0),
+    droppedNewest(0), blockedPushes(0), maxDepth(0), consumerWaiting(false) {
+
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    mask = size - 1;
+    cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool IngestQueue::tryPush(const Reading& reading) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->reading = reading;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool IngestQueue::tryPop(Reading& reading) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    reading = cell->reading;
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    popped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool IngestQueue::push(const Reading& reading) {
+    bool blocked = false;
+    while (!tryPush(reading)) {
+        if (policy == OverflowPolicy::DROP_NEWEST) {
+            droppedNewest.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (policy == OverflowPolicy::DROP_OLDEST) {
+            Reading discarded;
+            if (tryPop(discarded)) {
+                popped.fetch_sub(1, std::memory_order_relaxed);
+                droppedOldest.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+        if (!blocked) {
+            blocked = true;
+            blockedPushes.fetch_add(1, std::memory_order_relaxed);
+        }
+        wakeConsumer();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    pushed.fetch_add(1, std::memory_order_relaxed);
+    size_t currentDepth = depth();
+    size_t previousMax = maxDepth.load(std::memory_order_relaxed);
+    while (currentDepth > previousMax && !maxDepth.compare_exchange_weak(previousMax, currentDepth, std::memory_order_relaxed)) {}
+
+    wakeConsumer();
+    return true;
+}
+
+void IngestQueue::wakeConsumer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerWaiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        notEmpty.notify_all();
+    }
+}
+
+// A producer publishes the cell sequence, then reads the waiting flag; the
+// consumer raises the flag, then reads the sequence. Without the seq_cst
+// fences on both sides each load may pass the other side's store, so both
+// could miss each other and the sample would wait out the whole timeout.
+// With them, either the producer sees the flag and notifies under waitMutex,
+// which the consumer holds until it waits, or the consumer's check finds the
+// sample.
+bool IngestQueue::pop(Reading& reading, std::chrono::milliseconds timeout) {
+    if (tryPop(reading)) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(waitMutex);
+    consumerWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool found = notEmpty.wait_for(lock, timeout, [&]() { return tryPop(reading); });
+    consumerWaiting.store(false, std::memory_order_relaxed);
+    return found;
+}
+
+size_t IngestQueue::depth() const {
+    size_t enqueued = enqueuePos.load(std::memory_order_relaxed);
+    size_t dequeued = dequeuePos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+IngestQueueStats IngestQueue::stats() const {
+    return IngestQueueStats{
+        pushed.load(std::memory_order_relaxed),
+        popped.load(std::memory_order_relaxed),
+        droppedOldest.load(std::memory_order_relaxed),
+        droppedNewest.load(std::memory_order_relaxed),
+        blockedPushes.load(std::memory_order_relaxed),
+        depth(),
+        maxDepth.load(std::memory_order_relaxed)
+    };
+}
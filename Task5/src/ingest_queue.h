@@ -0,0 +1,81 @@
+#ifndef INGEST_QUEUE_H
+#define INGEST_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "response_format.h"
+
+enum class OverflowPolicy {
+    BLOCK,
+    DROP_OLDEST,
+    DROP_NEWEST
+};
+
+struct IngestQueueStats {
+    std::uint64_t pushed;
+    std::uint64_t popped;
+    std::uint64_t droppedOldest;
+    std::uint64_t droppedNewest;
+    std::uint64_t blockedPushes;
+    size_t depth;
+    size_t maxDepth;
+};
+
+// Bounded multi-producer/multi-consumer ring buffer of readings (Dmitry
+// Vyukov's design): every cell carries a sequence number that tells producers
+// and consumers whose turn it is, so push and pop are a single CAS on the
+// shared position plus one store, with no lock. The only lock guards the
+// consumer's sleep when the queue is empty and is touched by producers only
+// while a consumer is actually waiting.
+//
+// When the queue is full, push() follows the overflow policy: BLOCK waits for
+// room, DROP_OLDEST discards the oldest queued sample, DROP_NEWEST discards
+// the sample being pushed. Drops are counted, never silent.
+class IngestQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Reading reading;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    OverflowPolicy policy;
+
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+
+    alignas(64) std::atomic<std::uint64_t> pushed;
+    std::atomic<std::uint64_t> popped;
+    std::atomic<std::uint64_t> droppedOldest;
+    std::atomic<std::uint64_t> droppedNewest;
+    std::atomic<std::uint64_t> blockedPushes;
+    std::atomic<size_t> maxDepth;
+
+    std::atomic<bool> consumerWaiting;
+    std::mutex waitMutex;
+    std::condition_variable notEmpty;
+
+    bool tryPush(const Reading& reading);
+    void wakeConsumer();
+
+public:
+    // capacity is rounded up to a power of two.
+    IngestQueue(size_t capacity, OverflowPolicy policy);
+
+    // Returns false only when the sample was dropped.
+    bool push(const Reading& reading);
+    bool tryPop(Reading& reading);
+    // Waits up to timeout for a sample.
+    bool pop(Reading& reading, std::chrono::milliseconds timeout);
+
+    size_t capacity() const { return mask + 1; }
+    size_t depth() const;
+    IngestQueueStats stats() const;
+};
+
+#endif
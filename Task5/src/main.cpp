@@ -9,8 +9,13 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstdlib>
 #include "data_aggregator.h"
 #include "server.h"
+#include "reading_broadcaster.h"
+#include "ingest_queue.h"
+#include "rollup.h"
+#include "timestamp.h"
 
 #define DATA_CURRENT "data_current"
 #define DATA_HOUR "data_hour"
@@ -24,13 +29,41 @@
     #include <unistd.h>
 #endif
 
+// One serial port per sensor; a sensor's id is its position in the list.
 #if defined(_WIN32)
 #include <windows.h>
-#define PORT_NAME L"COM4"
+typedef const wchar_t* PortName;
+#define PORT_NAMES { L"COM4" }
 #else
-#define PORT_NAME "/dev/pts/4" 
+typedef const char* PortName;
+#define PORT_NAMES { "/dev/pts/4" }
 #endif
 
+// Group commit: writes share one transaction of up to GROUP_COMMIT_ROWS rows
+// that is committed at the latest GROUP_COMMIT_WINDOW_MS after it was opened.
+#define GROUP_COMMIT_ROWS 1000
+#define GROUP_COMMIT_WINDOW_MS 1000
+
+// Readings of all ports wait here for the storage writer, so a slow write
+// never stalls a port. Sized for about an hour of readings per sensor.
+#define INGEST_QUEUE_CAPACITY 4096
+#define INGEST_OVERFLOW_POLICY OverflowPolicy::DROP_OLDEST
+#define INGEST_STATS_INTERVAL_SECONDS 60
+
+// Retention drops whole partitions: data_current is split per UTC day and the
+// rollups per UTC month, so each table keeps up to one partition beyond its
+// retention period.
+#define CURRENT_PARTITIONS PartitionScheme::DAILY
+#define ROLLUP_PARTITIONS PartitionScheme::MONTHLY
+
+// data_current's retention window is also kept in memory for /data queries;
+// room for one reading per second plus some slack.
+#define HOT_TIER_CAPACITY (25 * 60 * 60)
+
+// Engine for all three tables. The STORAGE_ENGINE environment variable
+// ("sqlite", "text", "records", "memory" or "blocks") overrides it at startup.
+#define STORAGE_ENGINE StorageEngine::SQLITE
+
 #define FLOAT_REGEX R"(\[([-+]?\d{1,2}\.\d+)\])"
 
 
@@ -43,27 +76,52 @@ LPCSTR wstringToLPCSTR(const std::wstring& wideStr) {
     WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), -1, narrowStr, len, nullptr, nullptr);
 
     return narrowStr;
+}
 #endif
 
-std::mutex dbMutex;
+StorageEngine selectStorageEngine() {
+    StorageEngine engine = STORAGE_ENGINE;
+    const char* name = std::getenv("STORAGE_ENGINE");
+    if (name && !parseStorageEngine(name, engine)) {
+        std::cerr << "Unknown storage engine " << name << ", using " << storageEngineName(engine) << std::endl;
+    }
+    return engine;
+}
+
+std::mutex& writerMutex = getConnectionManager().getWriterMutex();
+const StorageEngine storageEngine = selectStorageEngine();
+
+DataAggregator aggregatorDay(DATA_DAY, TimeResolution::DAY, writerMutex, ROLLUP_PARTITIONS, storageEngine);
+DataAggregator aggregatorHour(DATA_HOUR, TimeResolution::HOUR, writerMutex, ROLLUP_PARTITIONS, storageEngine);
+DataAggregator aggregatorCurrent(DATA_CURRENT, TimeResolution::CURRENT, writerMutex, CURRENT_PARTITIONS, storageEngine);
+
+const PortName portNames[] = PORT_NAMES;
+const int SENSOR_COUNT = static_cast<int>(sizeof(portNames) / sizeof(portNames[0]));
+
+struct SensorRollups {
+    Rollup hour;
+    Rollup day;
+};
 
-DataAggregator aggregatorDay(DATA_DAY, TimeResolution::DAY, dbMutex);
-DataAggregator aggregatorHour(DATA_HOUR, TimeResolution::HOUR, dbMutex);
-DataAggregator aggregatorCurrent(DATA_CURRENT, TimeResolution::CURRENT, dbMutex);
+// Indexed by sensor id; filled in main() before any thread starts and never
+// resized, since each hour rollup points at the day rollup next to it.
+std::vector<SensorRollups> rollups;
 
+IngestQueue ingestQueue(INGEST_QUEUE_CAPACITY * SENSOR_COUNT, INGEST_OVERFLOW_POLICY);
 
-void monitorCurrentTemperature() {
+
+void monitorCurrentTemperature(int sensor) {
 #if defined(_WIN32)
-    HANDLE portHandle = CreateFile(wstringToLPCSTR(PORT_NAME), GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    HANDLE portHandle = CreateFile(wstringToLPCSTR(portNames[sensor]), GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
     if (portHandle == INVALID_HANDLE_VALUE) {
-        std::cerr << "Unable to open the port: " << PORT_NAME << std::endl;
+        std::cerr << "Unable to open the port of sensor " << sensor << std::endl;
         return;
     }
     DWORD bytesRead;
 #else
-    int portFd = open(PORT_NAME.c_str(), O_RDONLY);
+    int portFd = open(portNames[sensor], O_RDONLY);
     if (portFd < 0) {
-        std::cerr << "Unable to open the port: " << PORT_NAME << std::endl;
+        std::cerr << "Unable to open the port: " << portNames[sensor] << std::endl;
         return;
     }
 #endif
@@ -96,7 +154,9 @@ void monitorCurrentTemperature() {
         if (lastMatch.size() > 1) {
                 try {
                     float lastTemperature = std::stof(lastMatch.str(1));
-                    aggregatorCurrent.addTemperature(lastTemperature);
+                    Reading reading{sensor, Sample{static_cast<std::int64_t>(std::time(nullptr)), lastTemperature}};
+                    ingestQueue.push(reading);
+                    getReadingBroadcaster().publish(reading);
                 } catch (const std::invalid_argument& e) {
                     std::cerr << "Invalid temperature format: " << lastMatch.str(1) << std::endl;
                 } catch (const std::out_of_range& e) {
@@ -113,74 +173,93 @@ void monitorCurrentTemperature() {
 #endif
 }
 
-void monitorTemperature(
-    DataAggregator& aggregatorSource,
-    DataAggregator& aggregatorDest,
-    std::chrono::hours timeStep,
-    const std::string& aggregatorName) {
-
-    auto firstTime = aggregatorSource.getFirstDate();
-    auto lastTime = aggregatorDest.getLastDate() + timeStep;
+void storeCurrentTemperature() {
+    IngestQueueStats reported = ingestQueue.stats();
+    auto lastReport = std::chrono::steady_clock::now();
 
-    auto startTime = (firstTime > lastTime) ? firstTime : lastTime;
-
-    std::time_t startTime_t = std::chrono::system_clock::to_time_t(startTime);
-    std::tm* startTimeTM = std::localtime(&startTime_t);
-    if (startTimeTM) {
-        startTimeTM->tm_min = 0;
-        startTimeTM->tm_sec = 0;
-        if (timeStep == std::chrono::hours(24)) { 
-           startTimeTM->tm_hour = 0;
+    while (true) {
+        Reading reading;
+        if (ingestQueue.pop(reading, std::chrono::seconds(1))) {
+            const Sample& sample = reading.sample;
+            aggregatorCurrent.addTemperature(reading.sensor, static_cast<float>(sample.temperature),
+                                             std::chrono::system_clock::from_time_t(static_cast<std::time_t>(sample.epoch)));
+            rollups[reading.sensor].hour.add(sample);
+        }
+        std::int64_t nowEpoch = static_cast<std::int64_t>(std::time(nullptr));
+        for (SensorRollups& sensorRollups : rollups) {
+            sensorRollups.hour.tick(nowEpoch);
+            sensorRollups.day.tick(nowEpoch);
         }
-        startTime = std::chrono::system_clock::from_time_t(mktime(startTimeTM));
-    } else {
-        std::cerr << "localtime failed\n";
-        startTime = std::chrono::system_clock::now();
-    }
-
-    auto now = std::chrono::system_clock::now();
-    auto currentTime = std::chrono::system_clock::to_time_t(now);
 
-    std::tm* currentTimeTM = std::localtime(&currentTime);
-    if (currentTimeTM) {
-        currentTimeTM->tm_min = 0;
-        currentTimeTM->tm_sec = 0;
-        if (timeStep == std::chrono::hours(24)) {
-            currentTimeTM->tm_hour = 0;
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(INGEST_STATS_INTERVAL_SECONDS)) {
+            lastReport = now;
+            IngestQueueStats stats = ingestQueue.stats();
+            if (stats.droppedOldest != reported.droppedOldest || stats.droppedNewest != reported.droppedNewest ||
+                stats.blockedPushes != reported.blockedPushes) {
+                std::cerr << "Ingest queue overflow: depth " << stats.depth << "/" << ingestQueue.capacity()
+                          << " (max " << stats.maxDepth << "), dropped oldest " << stats.droppedOldest
+                          << ", dropped newest " << stats.droppedNewest << ", blocked pushes " << stats.blockedPushes << std::endl;
+            }
+            reported = stats;
         }
-    } else {
-        std::cerr << "localtime failed\n";
-        return;
     }
+}
 
-    auto endLoopTime = std::chrono::system_clock::from_time_t(mktime(currentTimeTM));
-
-    for (auto currentTimePoint = startTime; currentTimePoint < endLoopTime; currentTimePoint += timeStep) {
-        auto nextTimePoint = currentTimePoint + timeStep;
-        float avgTemp = aggregatorSource.getAverageTemperature(currentTimePoint, nextTimePoint);
+// Writes every bucket of aggregatorDest that is missing between its last row
+// and the start of the current bucket. All missing buckets are computed by
+// one grouped scan of aggregatorSource and stored in one transaction.
+void monitorTemperature(
+    int sensor,
+    DataAggregator& aggregatorSource,
+    DataAggregator& aggregatorDest,
+    TimeResolution resolution,
+    const std::string& aggregatorName) {
 
-        std::time_t tt = std::chrono::system_clock::to_time_t(currentTimePoint);
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&tt), "%Y-%m-%d %H:%M:%S");
+    auto toEpoch = [](const std::chrono::system_clock::time_point& time) {
+        return static_cast<std::int64_t>(std::chrono::system_clock::to_time_t(time));
+    };
 
-        aggregatorDest.addTemperature(avgTemp, ss.str());
-        std::cout << "Added to " << aggregatorName << " aggregator: " << ss.str() << " [" << avgTemp << "]" << std::endl;
+    std::int64_t firstEpoch = bucketStart(toEpoch(aggregatorSource.getFirstDate(sensor)), resolution);
+    std::int64_t afterLastEpoch = nextBucketStart(bucketStart(toEpoch(aggregatorDest.getLastDate(sensor)), resolution), resolution);
+    std::int64_t startEpoch = std::max(firstEpoch, afterLastEpoch);
+    std::int64_t endEpoch = bucketStart(static_cast<std::int64_t>(std::time(nullptr)), resolution);
+    if (startEpoch >= endEpoch) {
+        return;
     }
-}
 
+    std::vector<Sample> buckets = aggregatorSource.getBucketAverages(sensor,
+        std::chrono::system_clock::from_time_t(static_cast<std::time_t>(startEpoch)),
+        std::chrono::system_clock::from_time_t(static_cast<std::time_t>(endEpoch)), resolution);
+    aggregatorDest.addTemperatures(sensor, buckets);
 
-void monitorHourTemperature() {
-    while (true) {
-        monitorTemperature(aggregatorCurrent, aggregatorHour, std::chrono::hours(1), "hour");
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+    std::ostringstream report;
+    for (const Sample& bucket : buckets) {
+        report << "Added to " << aggregatorName << " aggregator, sensor " << sensor << ": "
+               << formatLocalTimestamp(bucket.epoch) << " [" << bucket.temperature << "]\n";
     }
+    std::cout << report.str() << std::flush;
 }
 
 
-void monitorDayTemperature() {
-    while (true) {
-        monitorTemperature(aggregatorHour, aggregatorDay, std::chrono::hours(24), "day");
-        std::this_thread::sleep_for(std::chrono::seconds(100));
+// Fills the hour and day buckets that closed while the program was not
+// running, then restores the open buckets; from here on the rollups are
+// maintained per sample by storeCurrentTemperature. Sensors are caught up in
+// parallel: their scans run on separate read connections and only the final
+// inserts take turns on the writer.
+void catchUpRollups() {
+    std::int64_t now = static_cast<std::int64_t>(std::time(nullptr));
+    std::vector<std::thread> workers;
+    for (int sensor = 0; sensor < SENSOR_COUNT; ++sensor) {
+        workers.emplace_back([sensor, now]() {
+            monitorTemperature(sensor, aggregatorCurrent, aggregatorHour, TimeResolution::HOUR, "hour");
+            monitorTemperature(sensor, aggregatorHour, aggregatorDay, TimeResolution::DAY, "day");
+            rollups[sensor].hour.seed(aggregatorCurrent, now);
+            rollups[sensor].day.seed(aggregatorHour, now);
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
     }
 }
 
@@ -196,7 +275,17 @@ void removeUnactualTemperature() {
 
 
 void runServer() {
-    Server server(8080, getDatabase());
+    Server server(8080, getConnectionManager());
+    for (int sensor = 0; sensor < SENSOR_COUNT; ++sensor) {
+        if (const HotTier* tier = aggregatorCurrent.getHotTier(sensor)) {
+            server.addHotTier(DATA_CURRENT, sensor, *tier);
+        }
+    }
+    if (storageEngine != StorageEngine::SQLITE) {
+        server.addBackend(DATA_CURRENT, aggregatorCurrent.getBackend());
+        server.addBackend(DATA_HOUR, aggregatorHour.getBackend());
+        server.addBackend(DATA_DAY, aggregatorDay.getBackend());
+    }
     if (!server.initialize()) {
         std::cerr << "Cannot run server" << std::endl;
     } else {
@@ -205,16 +294,32 @@ void runServer() {
 }
 
 int main() {
+    getConnectionManager().setGroupCommit(GROUP_COMMIT_ROWS, std::chrono::milliseconds(GROUP_COMMIT_WINDOW_MS));
 
-    std::thread currentTemperatureThread(monitorCurrentTemperature);
-    std::thread hourTemperatureThread(monitorHourTemperature);
-    std::thread dayTemperatureThread(monitorDayTemperature);
+    std::vector<int> sensors;
+    for (int sensor = 0; sensor < SENSOR_COUNT; ++sensor) {
+        sensors.push_back(sensor);
+        rollups.push_back(SensorRollups{Rollup(aggregatorHour, TimeResolution::HOUR, sensor),
+                                        Rollup(aggregatorDay, TimeResolution::DAY, sensor)});
+    }
+    for (SensorRollups& sensorRollups : rollups) {
+        sensorRollups.hour.feed(sensorRollups.day);
+    }
+    aggregatorCurrent.enableHotTier(HOT_TIER_CAPACITY, sensors);
+    catchUpRollups();
+
+    std::vector<std::thread> portThreads;
+    for (int sensor = 0; sensor < SENSOR_COUNT; ++sensor) {
+        portThreads.emplace_back(monitorCurrentTemperature, sensor);
+    }
+    std::thread storeTemperatureThread(storeCurrentTemperature);
     std::thread cleanTemperatureThread(removeUnactualTemperature);
     std::thread serverThread(runServer);
 
-    currentTemperatureThread.join();
-    hourTemperatureThread.join();
-    dayTemperatureThread.join();
+    for (std::thread& portThread : portThreads) {
+        portThread.join();
+    }
+    storeTemperatureThread.join();
     cleanTemperatureThread.join();
     serverThread.join();
 
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "schema.h"
+
+#define DEFAULT_DB_PATH "logs.db"
+#define BUSY_TIMEOUT_MS 5000
+
+// Converts every table of a logs database that still uses the TEXT timestamp
+// key to the epoch schema. Safe to run while the server is up: each table is
+// rewritten in its own transaction and the writer waits on the busy timeout.
+// With --vacuum the freed pages are returned to the file system afterwards.
+
+static long long pageBytes(sqlite3* db) {
+    sqlite3_stmt* stmt = nullptr;
+    long long bytes = 0;
+    if (sqlite3_prepare_v2(db, "SELECT page_count * page_size FROM pragma_page_count, pragma_page_size",
+                           -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        bytes = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return bytes;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = DEFAULT_DB_PATH;
+    bool vacuum = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--vacuum") {
+            vacuum = true;
+        } else {
+            path = arg;
+        }
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+    sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr);
+
+    std::vector<std::string> tables;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%'",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            tables.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    long long sizeBefore = pageBytes(db);
+    int failures = 0;
+    for (const std::string& table : tables) {
+        if (!isLegacyTable(db, table)) {
+            std::cout << table << ": already migrated" << std::endl;
+            continue;
+        }
+        long long converted = 0;
+        if (migrateTable(db, table, converted)) {
+            std::cout << table << ": " << converted << " rows converted" << std::endl;
+        } else {
+            std::cerr << table << ": migration failed" << std::endl;
+            ++failures;
+        }
+    }
+
+    if (vacuum && sqlite3_exec(db, "VACUUM", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "VACUUM failed: " << sqlite3_errmsg(db) << std::endl;
+    }
+    std::cout << "Database size: " << sizeBefore << " -> " << pageBytes(db) << " bytes" << std::endl;
+
+    sqlite3_close(db);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+#include "partitions.h"
+#include "schema.h"
+#include "timestamp.h"
+#include <iostream>
+#include <ctime>
+
+static bool execute(sqlite3* db, const std::string& sql) {
+    char* errmsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+        return false;
+    }
+    return true;
+}
+
+static std::string quote(const std::string& name) {
+    return "\"" + name + "\"";
+}
+
+// Runs body inside a savepoint, which nests in an open group-commit batch as
+// well as working on its own.
+template <typename Body>
+static bool inSavepoint(sqlite3* db, Body body) {
+    if (!execute(db, "SAVEPOINT partitions")) {
+        return false;
+    }
+    if (!body()) {
+        execute(db, "ROLLBACK TO partitions");
+        execute(db, "RELEASE partitions");
+        return false;
+    }
+    return execute(db, "RELEASE partitions");
+}
+
+PartitionedTable::PartitionedTable(const std::string& table, PartitionScheme scheme) :
+    table(table), scheme(scheme), currentStart(0), currentEnd(0) {}
+
+void PartitionedTable::bounds(std::int64_t epoch, std::int64_t& start, std::int64_t& end, std::string& name) const {
+    std::time_t time = static_cast<std::time_t>(epoch);
+    std::tm utcTime{};
+#if defined(_WIN32)
+    gmtime_s(&utcTime, &time);
+#else
+    gmtime_r(&time, &utcTime);
+#endif
+
+    std::int64_t year = utcTime.tm_year + 1900;
+    unsigned month = static_cast<unsigned>(utcTime.tm_mon + 1);
+    char suffix[16];
+    if (scheme == PartitionScheme::DAILY) {
+        std::strftime(suffix, sizeof(suffix), "%Y%m%d", &utcTime);
+        start = daysFromCivil(year, month, static_cast<unsigned>(utcTime.tm_mday)) * 86400;
+        end = start + 86400;
+    } else {
+        std::strftime(suffix, sizeof(suffix), "%Y%m", &utcTime);
+        start = daysFromCivil(year, month, 1) * 86400;
+        end = (month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1)) * 86400;
+    }
+    name = table + "__" + suffix;
+}
+
+std::int64_t PartitionedTable::startOf(std::int64_t epoch) const {
+    std::int64_t start, end;
+    std::string name;
+    bounds(epoch, start, end, name);
+    return start;
+}
+
+bool PartitionedTable::rebuildView(sqlite3* db) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT name FROM partitions WHERE parent = ? ORDER BY start_epoch", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+
+    std::string select;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (!select.empty()) {
+            select += " UNION ALL ";
+        }
+        select += "SELECT sensor_id, epoch, temperature FROM " + quote(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+
+    if (select.empty()) {
+        select = "SELECT CAST(NULL AS INTEGER) AS sensor_id, CAST(NULL AS INTEGER) AS epoch, "
+                 "CAST(NULL AS REAL) AS temperature WHERE 0";
+    }
+    return execute(db, "DROP VIEW IF EXISTS " + quote(table)) &&
+           execute(db, "CREATE VIEW " + quote(table) + " AS " + select);
+}
+
+bool PartitionedTable::initialize(sqlite3* db) {
+    if (!isPartitioned()) {
+        return ensureTable(db, table);
+    }
+
+    return inSavepoint(db, [&]() {
+        if (!execute(db, "CREATE TABLE IF NOT EXISTS partitions (name TEXT PRIMARY KEY, parent TEXT, "
+                         "start_epoch INTEGER, end_epoch INTEGER) WITHOUT ROWID")) {
+            return false;
+        }
+
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(db, "SELECT type FROM sqlite_master WHERE name = ?", -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+        std::string type = sqlite3_step(stmt) == SQLITE_ROW ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) : "";
+        sqlite3_finalize(stmt);
+
+        // Partitions written by older versions are brought to the current
+        // schema; the view over them is rebuilt at the end anyway.
+        if (type == "view") {
+            std::vector<std::string> existing;
+            sqlite3_prepare_v2(db, "SELECT name FROM partitions WHERE parent = ?", -1, &stmt, nullptr);
+            sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                existing.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+            }
+            sqlite3_finalize(stmt);
+
+            if (!execute(db, "DROP VIEW " + quote(table))) {
+                return false;
+            }
+            for (const std::string& name : existing) {
+                if (!ensureTable(db, name)) {
+                    return false;
+                }
+            }
+        } else if (type == "table") {
+            if (!ensureTable(db, table)) {
+                return false;
+            }
+            std::int64_t first = 0, last = 0;
+            sqlite3_prepare_v2(db, ("SELECT MIN(epoch), MAX(epoch) FROM " + quote(table)).c_str(), -1, &stmt, nullptr);
+            bool hasRows = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL;
+            if (hasRows) {
+                first = sqlite3_column_int64(stmt, 0);
+                last = sqlite3_column_int64(stmt, 1);
+            }
+            sqlite3_finalize(stmt);
+
+            std::string legacy = table + "__legacy";
+            if (!execute(db, "ALTER TABLE " + quote(table) + " RENAME TO " + quote(legacy))) {
+                return false;
+            }
+            // Existing rows are copied into their partitions once, so later
+            // writes and retention never have to look at the old table.
+            for (std::int64_t epoch = first; hasRows && epoch <= last; epoch = currentEnd) {
+                std::string name = partitionFor(db, epoch);
+                if (name.empty() ||
+                    !execute(db, "INSERT INTO " + quote(name) + " SELECT sensor_id, epoch, temperature FROM " + quote(legacy) +
+                                 " WHERE epoch >= " + std::to_string(currentStart) + " AND epoch < " + std::to_string(currentEnd))) {
+                    return false;
+                }
+            }
+            if (!execute(db, "DROP TABLE " + quote(legacy))) {
+                return false;
+            }
+            if (hasRows) {
+                std::cout << "Split table " << table << " into partitions" << std::endl;
+            }
+        }
+        return rebuildView(db);
+    }) && !partitionFor(db, static_cast<std::int64_t>(std::time(nullptr))).empty();
+}
+
+std::string PartitionedTable::partitionFor(sqlite3* db, std::int64_t epoch) {
+    if (!isPartitioned()) {
+        return table;
+    }
+    if (!currentName.empty() && epoch >= currentStart && epoch < currentEnd) {
+        return currentName;
+    }
+
+    std::int64_t start, end;
+    std::string name;
+    bounds(epoch, start, end, name);
+
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db, "SELECT 1 FROM partitions WHERE name = ?", -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+
+    if (!exists) {
+        bool created = inSavepoint(db, [&]() {
+            return execute(db, createTableSql(name)) &&
+                   execute(db, "INSERT INTO partitions VALUES ('" + name + "', '" + table + "', " +
+                               std::to_string(start) + ", " + std::to_string(end) + ")") &&
+                   rebuildView(db);
+        });
+        if (!created) {
+            std::cerr << "Failed to create partition " << name << std::endl;
+            return "";
+        }
+    }
+
+    currentName = name;
+    currentStart = start;
+    currentEnd = end;
+    return name;
+}
+
+std::vector<std::string> PartitionedTable::dropBefore(sqlite3* db, std::int64_t cutoff) {
+    std::vector<std::string> expired;
+    if (!isPartitioned()) {
+        return expired;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db, "SELECT name FROM partitions WHERE parent = ? AND end_epoch <= ?", -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, cutoff);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        expired.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+    if (expired.empty()) {
+        return expired;
+    }
+
+    bool dropped = inSavepoint(db, [&]() {
+        for (const std::string& name : expired) {
+            if (!execute(db, "DROP TABLE IF EXISTS " + quote(name)) ||
+                !execute(db, "DELETE FROM partitions WHERE name = '" + name + "'")) {
+                return false;
+            }
+        }
+        return rebuildView(db);
+    });
+    if (!dropped) {
+        expired.clear();
+    }
+    if (currentEnd <= cutoff) {
+        currentName.clear();
+    }
+    return expired;
+}
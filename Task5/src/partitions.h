@@ -0,0 +1,52 @@
+#ifndef PARTITIONS_H
+#define PARTITIONS_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <sqlite3.h>
+#include "statement_cache.h"
+
+enum class PartitionScheme {
+    NONE,
+    DAILY,
+    MONTHLY
+};
+
+// Splits a measurement table into one table per UTC day or month, named
+// <table>__YYYYMMDD or <table>__YYYYMM and listed in the "partitions" table.
+// <table> itself becomes a UNION ALL view over them in time order; SQLite
+// merges the arms for ORDER BY epoch and pushes epoch ranges into each arm,
+// so every reader keeps querying <table> unchanged. Rows are written to the
+// partition that covers their epoch, and retention drops whole partitions.
+//
+// A plain table found at <table> is split into partitions on first start. With
+// PartitionScheme::NONE every method falls through to the plain table.
+// All methods run on the writer connection with the writer mutex held.
+class PartitionedTable {
+private:
+    std::string table;
+    PartitionScheme scheme;
+    std::string currentName;
+    std::int64_t currentStart;
+    std::int64_t currentEnd;
+
+    void bounds(std::int64_t epoch, std::int64_t& start, std::int64_t& end, std::string& name) const;
+    bool rebuildView(sqlite3* db);
+
+public:
+    PartitionedTable(const std::string& table, PartitionScheme scheme);
+
+    bool isPartitioned() const { return scheme != PartitionScheme::NONE; }
+
+    bool initialize(sqlite3* db);
+    // Start of the partition that covers epoch, whether or not it exists.
+    std::int64_t startOf(std::int64_t epoch) const;
+    // Table that rows with this epoch are written to; creates the partition if needed.
+    std::string partitionFor(sqlite3* db, std::int64_t epoch);
+    // Drops every partition whose rows are all older than cutoff and returns
+    // their names.
+    std::vector<std::string> dropBefore(sqlite3* db, std::int64_t cutoff);
+};
+
+#endif
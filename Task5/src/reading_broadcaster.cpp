@@ -0,0 +1,97 @@
+#include "reading_broadcaster.h"
+#include <cstdlib>
+
+// Shared by all sensors, so it covers a few seconds of a few dozen probes.
+#define READING_HISTORY 1024
+
+ReadingBroadcaster& getReadingBroadcaster() {
+    static ReadingBroadcaster broadcaster;
+    return broadcaster;
+}
+
+// The start time in microseconds tells the instances of the server apart.
+ReadingBroadcaster::ReadingBroadcaster() :
+    instance(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count())),
+    nextSequence(1), nextListenerId(0) {}
+
+void ReadingBroadcaster::publish(const Reading& reading) {
+    std::vector<std::function<void()>> toNotify;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        recent.push_back(reading);
+        if (recent.size() > READING_HISTORY) {
+            recent.pop_front();
+        }
+        ++nextSequence;
+        for (const auto& listener : listeners) {
+            toNotify.push_back(listener.second);
+        }
+    }
+    published.notify_all();
+    for (const auto& listener : toNotify) {
+        listener();
+    }
+}
+
+void ReadingBroadcaster::readSince(std::uint64_t& sequence, std::vector<Reading>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::uint64_t oldest = nextSequence - recent.size();
+    if (sequence < oldest) {
+        sequence = oldest;
+    } else if (sequence > nextSequence) {
+        sequence = nextSequence;
+    }
+    for (; sequence < nextSequence; ++sequence) {
+        out.push_back(recent[sequence - oldest]);
+    }
+}
+
+std::uint64_t ReadingBroadcaster::latestSequence() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recent.empty() ? nextSequence : nextSequence - 1;
+}
+
+std::string ReadingBroadcaster::eventId(std::uint64_t sequence) const {
+    return std::to_string(instance) + "-" + std::to_string(sequence);
+}
+
+std::uint64_t ReadingBroadcaster::resumeSequence(const std::string& lastEventId) {
+    char* parseEnd = nullptr;
+    std::uint64_t idInstance = std::strtoull(lastEventId.c_str(), &parseEnd, 10);
+    if (idInstance != instance || *parseEnd != '-') {
+        return latestSequence();
+    }
+    const char* sequenceText = parseEnd + 1;
+    std::uint64_t sequence = std::strtoull(sequenceText, &parseEnd, 10);
+    if (parseEnd == sequenceText || *parseEnd != '\0') {
+        return latestSequence();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sequence >= nextSequence) {
+        return recent.empty() ? nextSequence : nextSequence - 1;
+    }
+    return sequence + 1;
+}
+
+bool ReadingBroadcaster::waitForReading(std::uint64_t sequence, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return published.wait_for(lock, timeout, [&]() { return nextSequence > sequence; });
+}
+
+int ReadingBroadcaster::addListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listeners.emplace_back(nextListenerId, std::move(listener));
+    return nextListenerId++;
+}
+
+void ReadingBroadcaster::removeListener(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+        if (it->first == id) {
+            listeners.erase(it);
+            return;
+        }
+    }
+}
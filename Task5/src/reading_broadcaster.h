@@ -0,0 +1,54 @@
+#ifndef READING_BROADCASTER_H
+#define READING_BROADCASTER_H
+
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "response_format.h"
+
+// Fans every new current-temperature reading out to push subscribers without
+// going through the database. The most recent readings are kept with
+// increasing sequence numbers, so a subscriber only has to remember the last
+// sequence it has seen and can catch up after a short stall or a reconnect.
+// Sequences start over with every process, so the ids handed to clients also
+// carry the instance they came from.
+class ReadingBroadcaster {
+private:
+    std::deque<Reading> recent;
+    std::uint64_t instance;
+    std::uint64_t nextSequence;
+    std::vector<std::pair<int, std::function<void()>>> listeners;
+    int nextListenerId;
+    std::mutex mutex;
+    std::condition_variable published;
+
+public:
+    ReadingBroadcaster();
+
+    void publish(const Reading& reading);
+
+    // Appends the readings after `sequence` to out and advances `sequence`.
+    // A subscriber that fell further behind than the history skips the gap.
+    void readSince(std::uint64_t& sequence, std::vector<Reading>& out);
+    // Sequence to start from so that the latest reading is delivered first.
+    std::uint64_t latestSequence();
+    // "<instance>-<sequence>", the id a client remembers to resume from.
+    std::string eventId(std::uint64_t sequence) const;
+    // Sequence after the one lastEventId names. An id from another process
+    // or past the newest reading starts from the latest reading instead.
+    std::uint64_t resumeSequence(const std::string& lastEventId);
+    bool waitForReading(std::uint64_t sequence, std::chrono::milliseconds timeout);
+
+    // Listeners run on the publishing thread and must only schedule work.
+    int addListener(std::function<void()> listener);
+    void removeListener(int id);
+};
+
+ReadingBroadcaster& getReadingBroadcaster();
+
+#endif
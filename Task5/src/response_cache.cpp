@@ -0,0 +1,48 @@
+#include "response_cache.h"
+
+ResponseCache::ResponseCache(size_t maxBytes, size_t maxEntryBytes) :
+    maxBytes(maxBytes), maxEntryBytes(maxEntryBytes), usedBytes(0) {}
+
+void ResponseCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    usedBytes -= it->first.size() + it->second.response->body.size();
+    lru.erase(it->second.position);
+    entries.erase(it);
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::lookup(const std::string& key, std::uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return nullptr;
+    }
+    if (it->second.response->version != version) {
+        erase(it);
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second.position);
+    return it->second.response;
+}
+
+void ResponseCache::store(const std::string& key, std::shared_ptr<const CachedResponse> response) {
+    size_t size = key.size() + response->body.size();
+    if (size > maxEntryBytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        if (it->second.response->version > response->version) {
+            return;
+        }
+        erase(it);
+    }
+
+    while (usedBytes + size > maxBytes && !lru.empty()) {
+        erase(entries.find(lru.back()));
+    }
+
+    lru.push_front(key);
+    entries.emplace(key, Entry{std::move(response), lru.begin()});
+    usedBytes += size;
+}
@@ -0,0 +1,46 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+struct CachedResponse {
+    std::uint64_t version;
+    std::string contentType;
+    std::string body;
+};
+
+// Bounded LRU cache of complete response bodies. Every entry records the
+// table version it was built from; a lookup with a newer version misses and
+// drops the entry, so writes invalidate without having to enumerate keys.
+class ResponseCache {
+private:
+    typedef std::list<std::string> LruList;
+
+    struct Entry {
+        std::shared_ptr<const CachedResponse> response;
+        LruList::iterator position;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    LruList lru;
+    std::mutex mutex;
+    size_t maxBytes;
+    size_t maxEntryBytes;
+    size_t usedBytes;
+
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+public:
+    ResponseCache(size_t maxBytes, size_t maxEntryBytes);
+
+    size_t getMaxEntryBytes() const { return maxEntryBytes; }
+    std::shared_ptr<const CachedResponse> lookup(const std::string& key, std::uint64_t version);
+    void store(const std::string& key, std::shared_ptr<const CachedResponse> response);
+};
+
+#endif
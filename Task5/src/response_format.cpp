@@ -0,0 +1,149 @@
+#include "response_format.h"
+#include "timestamp.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <ctime>
+
+bool negotiateFormat(const std::string& formatParam, const std::string& acceptHeader, ResponseFormat& format) {
+    if (formatParam == "text") {
+        format = ResponseFormat::TEXT;
+    } else if (formatParam == "json") {
+        format = ResponseFormat::JSON;
+    } else if (formatParam == "binary") {
+        format = ResponseFormat::BINARY;
+    } else if (!formatParam.empty()) {
+        return false;
+    } else if (acceptHeader.find("application/octet-stream") != std::string::npos) {
+        format = ResponseFormat::BINARY;
+    } else if (acceptHeader.find("application/json") != std::string::npos) {
+        format = ResponseFormat::JSON;
+    } else {
+        format = ResponseFormat::TEXT;
+    }
+    return true;
+}
+
+const char* contentTypeFor(ResponseFormat format) {
+    switch (format) {
+        case ResponseFormat::JSON:
+            return "application/json";
+        case ResponseFormat::BINARY:
+            return "application/octet-stream";
+        case ResponseFormat::TEXT:
+            break;
+    }
+    return "text/plain";
+}
+
+static int putLittleEndian(char* buffer, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        buffer[i] = static_cast<char>(value >> (8 * i));
+    }
+    return bytes;
+}
+
+static int putFloat(char* buffer, double value) {
+    float narrowed = static_cast<float>(value);
+    std::uint32_t bits;
+    std::memcpy(&bits, &narrowed, sizeof(bits));
+    return putLittleEndian(buffer, bits, 4);
+}
+
+SampleEncoder::SampleEncoder(ResponseFormat format, const std::string& title) :
+    format(format), title(title), first(true) {}
+
+void SampleEncoder::begin(std::string& output) {
+    if (format == ResponseFormat::TEXT) {
+        output += title;
+    } else if (format == ResponseFormat::JSON) {
+        output += '[';
+    }
+}
+
+void SampleEncoder::append(std::string& output, const char* timestamp, std::int64_t epoch, double temperature) {
+    char buffer[128];
+    int length = 0;
+
+    switch (format) {
+        case ResponseFormat::TEXT:
+            length = snprintf(buffer, sizeof(buffer), "Date: %s, Temperature: %f\n", timestamp ? timestamp : "", temperature);
+            break;
+        case ResponseFormat::JSON:
+            length = snprintf(buffer, sizeof(buffer), "%s[%lld,%.7g]", first ? "" : ",",
+                              static_cast<long long>(epoch), temperature);
+            break;
+        case ResponseFormat::BINARY:
+            length = putLittleEndian(buffer, static_cast<std::uint64_t>(epoch), 8);
+            length += putFloat(buffer + length, temperature);
+            break;
+    }
+
+    first = false;
+    if (length > 0) {
+        output.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+    }
+}
+
+void SampleEncoder::append(std::string& output, const Sample& sample) {
+    char timestamp[32] = "";
+    if (format == ResponseFormat::TEXT) {
+        formatLocalTimestamp(sample.epoch, timestamp, sizeof(timestamp));
+    }
+    append(output, timestamp, sample.epoch, sample.temperature);
+}
+
+void SampleEncoder::end(std::string& output) {
+    if (format == ResponseFormat::JSON) {
+        output += ']';
+    }
+}
+
+BucketEncoder::BucketEncoder(ResponseFormat format) : format(format), first(true) {}
+
+void BucketEncoder::begin(std::string& output) {
+    if (format == ResponseFormat::TEXT) {
+        output += "Aggregated data:\n";
+    } else if (format == ResponseFormat::JSON) {
+        output += '[';
+    }
+}
+
+void BucketEncoder::append(std::string& output, const Bucket& bucket) {
+    char buffer[192];
+    int length = 0;
+    double average = bucket.count > 0 ? bucket.sum / bucket.count : 0.0;
+
+    switch (format) {
+        case ResponseFormat::TEXT: {
+            char timestamp[32];
+            formatLocalTimestamp(bucket.epoch, timestamp, sizeof(timestamp));
+            length = snprintf(buffer, sizeof(buffer), "Bucket: %s, Average: %f, Min: %f, Max: %f, Count: %lld\n",
+                              timestamp, average, bucket.min, bucket.max, static_cast<long long>(bucket.count));
+            break;
+        }
+        case ResponseFormat::JSON:
+            length = snprintf(buffer, sizeof(buffer), "%s[%lld,%.7g,%.7g,%.7g,%lld]", first ? "" : ",",
+                              static_cast<long long>(bucket.epoch), average, bucket.min, bucket.max,
+                              static_cast<long long>(bucket.count));
+            break;
+        case ResponseFormat::BINARY:
+            length = putLittleEndian(buffer, static_cast<std::uint64_t>(bucket.epoch), 8);
+            length += putFloat(buffer + length, average);
+            length += putFloat(buffer + length, bucket.min);
+            length += putFloat(buffer + length, bucket.max);
+            length += putLittleEndian(buffer + length, static_cast<std::uint32_t>(bucket.count), 4);
+            break;
+    }
+
+    first = false;
+    if (length > 0) {
+        output.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+    }
+}
+
+void BucketEncoder::end(std::string& output) {
+    if (format == ResponseFormat::JSON) {
+        output += ']';
+    }
+}
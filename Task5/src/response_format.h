@@ -0,0 +1,68 @@
+#ifndef RESPONSE_FORMAT_H
+#define RESPONSE_FORMAT_H
+
+#include <string>
+#include <cstdint>
+#include "sample.h"
+
+// A sample tagged with the sensor that produced it.
+struct Reading {
+    int sensor;
+    Sample sample;
+};
+
+enum class ResponseFormat {
+    TEXT,
+    JSON,
+    BINARY
+};
+
+// Picks the body format from an explicit format= value or, when that is empty,
+// from the Accept header. Returns false for an unknown format= value.
+bool negotiateFormat(const std::string& formatParam, const std::string& acceptHeader, ResponseFormat& format);
+
+const char* contentTypeFor(ResponseFormat format);
+
+// Writes samples in one of the /data body layouts:
+//   TEXT   - "Date: <timestamp>, Temperature: <value>" lines after a title line
+//   JSON   - [[<epoch seconds>,<temperature>],...]
+//   BINARY - packed little-endian records of int64 epoch seconds + float32
+//            temperature, 12 bytes per sample, no header
+// TEXT uses the timestamp string, the other formats the epoch.
+class SampleEncoder {
+private:
+    ResponseFormat format;
+    std::string title;
+    bool first;
+
+public:
+    SampleEncoder(ResponseFormat format, const std::string& title);
+
+    ResponseFormat getFormat() const { return format; }
+
+    void begin(std::string& output);
+    void append(std::string& output, const char* timestamp, std::int64_t epoch, double temperature);
+    // Formats the local timestamp from the epoch when the layout needs it.
+    void append(std::string& output, const Sample& sample);
+    void end(std::string& output);
+};
+
+// Writes /aggregate buckets in the same three layouts:
+//   TEXT   - "Bucket: <timestamp>, Average: .., Min: .., Max: .., Count: .." lines
+//   JSON   - [[<epoch>,<avg>,<min>,<max>,<count>],...]
+//   BINARY - little-endian int64 epoch, float32 avg, float32 min, float32 max,
+//            uint32 count; 24 bytes per bucket
+class BucketEncoder {
+private:
+    ResponseFormat format;
+    bool first;
+
+public:
+    explicit BucketEncoder(ResponseFormat format);
+
+    void begin(std::string& output);
+    void append(std::string& output, const Bucket& bucket);
+    void end(std::string& output);
+};
+
+#endif
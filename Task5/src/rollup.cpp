@@ -0,0 +1,64 @@
+#include "rollup.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+
+Rollup::Rollup(DataAggregator& destination, TimeResolution resolution, int sensor) :
+    destination(destination), resolution(resolution), sensor(sensor), next(nullptr), bucket{0, 0.0, 0.0, 0.0, 0}, bucketEnd(0), closed(true) {}
+
+void Rollup::open(std::int64_t epoch) {
+    bucket = Bucket{bucketStart(epoch, resolution), 0.0, 0.0, 0.0, 0};
+    bucketEnd = nextBucketStart(bucket.epoch, resolution);
+    closed = false;
+}
+
+void Rollup::feed(Rollup& next) {
+    this->next = &next;
+}
+
+void Rollup::flush() {
+    if (bucket.count > 0) {
+        float average = static_cast<float>(bucket.sum / bucket.count);
+        destination.addTemperature(sensor, average,
+                                   std::chrono::system_clock::from_time_t(static_cast<std::time_t>(bucket.epoch)));
+        if (next) {
+            next->add(Sample{bucket.epoch, average});
+        }
+    }
+    bucket.count = 0;
+    closed = true;
+}
+
+void Rollup::seed(DataAggregator& source, std::int64_t now) {
+    open(now);
+    bucket = source.getSummary(sensor, std::chrono::system_clock::from_time_t(static_cast<std::time_t>(bucket.epoch)),
+                               std::chrono::system_clock::from_time_t(static_cast<std::time_t>(bucketEnd)));
+}
+
+// Samples older than the current bucket, or that fall into a bucket already
+// written, are not counted: rewriting a closed bucket from a single late
+// sample would replace its real average.
+void Rollup::add(const Sample& sample) {
+    if (sample.epoch >= bucketEnd) {
+        flush();
+        open(sample.epoch);
+    } else if (closed || sample.epoch < bucket.epoch) {
+        return;
+    }
+
+    if (bucket.count == 0) {
+        bucket.min = sample.temperature;
+        bucket.max = sample.temperature;
+    }
+    bucket.sum += sample.temperature;
+    bucket.min = std::min(bucket.min, sample.temperature);
+    bucket.max = std::max(bucket.max, sample.temperature);
+    ++bucket.count;
+}
+
+void Rollup::tick(std::int64_t now) {
+    if (!closed && now >= bucketEnd) {
+        flush();
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <cstdint>
+#include "data_aggregator.h"
+#include "response_format.h"
+
+// Maintains one aggregate tier of one sensor from its samples. Only the open bucket
+// is kept: count, sum, min and max are updated per sample, and the bucket's
+// average is written to the destination once, when a sample or the clock
+// passes its end. Buckets follow local hours and midnights, the same as the
+// stored hour and day rows.
+//
+// A day row is the mean of the day's hour rows, not of its raw samples, so the
+// day rollup is fed the hour averages as they are written. That is also what
+// the startup catch-up computes from the hour table.
+class Rollup {
+private:
+    DataAggregator& destination;
+    TimeResolution resolution;
+    int sensor;
+    Rollup* next;
+    Bucket bucket;
+    std::int64_t bucketEnd;
+    bool closed;
+
+    void open(std::int64_t epoch);
+    void flush();
+
+public:
+    Rollup(DataAggregator& destination, TimeResolution resolution, int sensor);
+
+    // Every average this rollup writes is also added to next.
+    void feed(Rollup& next);
+    // Restores the open bucket after a restart from the rows already stored in
+    // source, the table this rollup's samples come from.
+    void seed(DataAggregator& source, std::int64_t now);
+    void add(const Sample& sample);
+    // Closes the open bucket if its end has passed without a newer sample.
+    void tick(std::int64_t now);
+};
+
+#endif
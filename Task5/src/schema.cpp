@@ -0,0 +1,81 @@
+#include "schema.h"
+#include <iostream>
+
+static bool execute(sqlite3* db, const std::string& sql) {
+    char* errmsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errmsg << std::endl;
+        sqlite3_free(errmsg);
+        return false;
+    }
+    return true;
+}
+
+std::string createTableSql(const std::string& table) {
+    return "CREATE TABLE IF NOT EXISTS \"" + table + "\" (sensor_id INTEGER NOT NULL, epoch INTEGER NOT NULL, "
+           "temperature REAL, PRIMARY KEY (sensor_id, epoch)) WITHOUT ROWID";
+}
+
+static bool hasColumn(sqlite3* db, const std::string& table, const char* column) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+bool isLegacyTable(sqlite3* db, const std::string& table) {
+    return hasColumn(db, table, "timestamp") || (hasColumn(db, table, "epoch") && !hasColumn(db, table, "sensor_id"));
+}
+
+bool migrateTable(sqlite3* db, const std::string& table, long long& converted) {
+    std::string quoted = "\"" + table + "\"";
+    std::string migrated = "\"" + table + "__epoch\"";
+    std::string sensor = std::to_string(DEFAULT_SENSOR);
+    std::string copy = hasColumn(db, table, "timestamp")
+        ? "SELECT " + sensor + ", CAST(strftime('%s', timestamp, 'utc') AS INTEGER), temperature FROM " + quoted +
+          " WHERE strftime('%s', timestamp, 'utc') IS NOT NULL ORDER BY timestamp"
+        : "SELECT " + sensor + ", epoch, temperature FROM " + quoted + " ORDER BY epoch";
+
+    // Inside a caller's transaction the conversion nests as a savepoint.
+    bool nested = !sqlite3_get_autocommit(db);
+    if (!execute(db, nested ? "SAVEPOINT migrate" : "BEGIN IMMEDIATE")) {
+        return false;
+    }
+
+    bool ok = execute(db, "DROP TABLE IF EXISTS " + migrated) &&
+              execute(db, createTableSql(table + "__epoch")) &&
+              execute(db, "INSERT OR REPLACE INTO " + migrated + " (sensor_id, epoch, temperature) " + copy);
+    converted = ok ? sqlite3_changes(db) : 0;
+    ok = ok && execute(db, "DROP TABLE " + quoted) &&
+         execute(db, "ALTER TABLE " + migrated + " RENAME TO " + quoted);
+
+    if (!ok) {
+        if (nested) {
+            execute(db, "ROLLBACK TO migrate");
+            execute(db, "RELEASE migrate");
+        } else {
+            execute(db, "ROLLBACK");
+        }
+        return false;
+    }
+    return execute(db, nested ? "RELEASE migrate" : "COMMIT");
+}
+
+bool ensureTable(sqlite3* db, const std::string& table) {
+    if (isLegacyTable(db, table)) {
+        long long converted = 0;
+        if (!migrateTable(db, table, converted)) {
+            std::cerr << "Failed to migrate table " << table << std::endl;
+            return false;
+        }
+        std::cout << "Migrated " << converted << " rows of " << table << " to the sensor schema" << std::endl;
+        return true;
+    }
+    return execute(db, createTableSql(table));
+}
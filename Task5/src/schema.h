@@ -0,0 +1,27 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <string>
+#include <sqlite3.h>
+
+// Measurement tables are keyed by sensor and UTC epoch seconds:
+//   (sensor_id INTEGER, epoch INTEGER, temperature REAL,
+//    PRIMARY KEY (sensor_id, epoch)) WITHOUT ROWID
+// Older databases had no sensor_id and were keyed by epoch alone or, before
+// that, by a local-time TEXT timestamp. Their rows belong to DEFAULT_SENSOR.
+#define DEFAULT_SENSOR 0
+
+std::string createTableSql(const std::string& table);
+
+bool isLegacyTable(sqlite3* db, const std::string& table);
+
+// Rewrites a legacy table into the current schema inside one transaction.
+// Readers in WAL mode keep seeing the old table until the commit, so the
+// conversion can run while the server is up. Rows whose timestamp cannot be
+// parsed are dropped; the number of rows kept is stored in converted.
+bool migrateTable(sqlite3* db, const std::string& table, long long& converted);
+
+// Creates the table if it is missing and migrates it if it is legacy.
+bool ensureTable(sqlite3* db, const std::string& table);
+
+#endif
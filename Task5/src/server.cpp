@@ -1,14 +1,287 @@
 #include "server.h"
+#include "timestamp.h"
+#include "schema.h"
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <cstdio>
 #include <thread>
 #include <string>
 #include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <climits>
 #include <stdexcept>
 
+#if !defined(WIN32)
+#   include <sys/epoll.h>
+#   include <sys/eventfd.h>
+#   include <fcntl.h>
+#   include <cerrno>
+#endif
+
+#if !defined(MSG_NOSIGNAL)
+#   define MSG_NOSIGNAL 0
+#endif
+
+#define MAX_REQUEST_SIZE 8192
+#define MAX_BUFFERED_INPUT (64 * 1024)
+#define OUTPUT_WATERMARK (64 * 1024)
+#define STREAM_CHUNK_SIZE (16 * 1024)
+#define MAX_EPOLL_EVENTS 256
+#define KEEP_ALIVE_TIMEOUT_SECONDS 15
+#define MAX_DOWNSAMPLE_POINTS 100000
+#define RESPONSE_CACHE_BYTES (64 * 1024 * 1024)
+#define MAX_CACHED_RESPONSE_BYTES (8 * 1024 * 1024)
+#define EVENT_HEARTBEAT_SECONDS 10
+
+struct Server::Connection {
+    SOCKET socket;
+    std::string input;
+    std::string output;
+    size_t outputOffset = 0;
+    std::unique_ptr<ResponseStream> stream;
+    bool keepAliveAfterStream = false;
+    bool inputClosed = false;
+    bool closeAfterWrite = false;
+    bool streamWaiting = false;
+    std::chrono::steady_clock::time_point lastActivity;
+
+    explicit Connection(SOCKET socket) : socket(socket), lastActivity(std::chrono::steady_clock::now()) {}
+
+    size_t pendingOutput() const { return output.size() - outputOffset; }
+};
+
+// Streams the samples of a range.
+class RangeStream : public ResponseStream {
+private:
+    std::unique_ptr<SampleCursor> cursor;
+    SampleEncoder encoder;
+    bool started;
+
+public:
+    RangeStream(std::unique_ptr<SampleCursor> cursor, ResponseFormat format) :
+        cursor(std::move(cursor)), encoder(format, "Temperature data:\n"), started(false) {}
+
+    bool fill(std::string& output, size_t limit) override {
+        if (!started) {
+            encoder.begin(output);
+            started = true;
+        }
+
+        Sample sample;
+        while (output.size() < limit) {
+            if (!cursor->next(sample)) {
+                encoder.end(output);
+                return false;
+            }
+            encoder.append(output, sample);
+        }
+        return true;
+    }
+};
+
+// Streams a range through a Downsampler, so only the selected samples are
+// encoded and sent.
+class DownsampleStream : public ResponseStream {
+private:
+    std::unique_ptr<SampleCursor> cursor;
+    SampleEncoder encoder;
+    Downsampler downsampler;
+    std::vector<Sample> selected;
+    bool started;
+
+    void encodeSelected(std::string& output) {
+        for (const Sample& sample : selected) {
+            encoder.append(output, sample);
+        }
+        selected.clear();
+    }
+
+public:
+    DownsampleStream(std::unique_ptr<SampleCursor> cursor, ResponseFormat format, Downsampler downsampler) :
+        cursor(std::move(cursor)), encoder(format, "Temperature data:\n"), downsampler(std::move(downsampler)), started(false) {}
+
+    bool fill(std::string& output, size_t limit) override {
+        if (!started) {
+            encoder.begin(output);
+            started = true;
+        }
+
+        Sample sample;
+        while (output.size() < limit) {
+            if (!cursor->next(sample)) {
+                downsampler.finish(selected);
+                encodeSelected(output);
+                encoder.end(output);
+                return false;
+            }
+            downsampler.add(sample, selected);
+            encodeSelected(output);
+        }
+        return true;
+    }
+};
+
+// Folds a range into fixed-width buckets in a single pass. Samples arrive in
+// timestamp order, so a bucket is complete as soon as a sample falls outside it.
+class AggregateStream : public ResponseStream {
+private:
+    std::unique_ptr<SampleCursor> cursor;
+    BucketEncoder encoder;
+    std::int64_t bucketSeconds;
+    Bucket bucket;
+    bool started;
+
+public:
+    AggregateStream(std::unique_ptr<SampleCursor> cursor, ResponseFormat format, std::int64_t bucketSeconds) :
+        cursor(std::move(cursor)), encoder(format), bucketSeconds(bucketSeconds), bucket{0, 0.0, 0.0, 0.0, 0}, started(false) {}
+
+    bool fill(std::string& output, size_t limit) override {
+        if (!started) {
+            encoder.begin(output);
+            started = true;
+        }
+
+        Sample sample;
+        while (output.size() < limit) {
+            if (!cursor->next(sample)) {
+                if (bucket.count > 0) {
+                    encoder.append(output, bucket);
+                }
+                encoder.end(output);
+                return false;
+            }
+
+            std::int64_t epoch = sample.epoch;
+            double temperature = sample.temperature;
+            std::int64_t bucketEpoch = epoch - ((epoch % bucketSeconds) + bucketSeconds) % bucketSeconds;
+
+            if (bucket.count > 0 && bucket.epoch != bucketEpoch) {
+                encoder.append(output, bucket);
+                bucket.count = 0;
+            }
+            if (bucket.count == 0) {
+                bucket = Bucket{bucketEpoch, 0.0, temperature, temperature, 0};
+            }
+            bucket.sum += temperature;
+            bucket.min = std::min(bucket.min, temperature);
+            bucket.max = std::max(bucket.max, temperature);
+            ++bucket.count;
+        }
+        return true;
+    }
+};
 
-Server::Server(int port, sqlite3* db) : PORT(port), serverSocket(INVALID_SOCKET), db(db) {}
+// Passes a streamed body through unchanged while keeping a copy, and stores
+// the copy in the response cache once the body is complete. Bodies that grow
+// past the cache's entry limit are only streamed.
+class CachingStream : public ResponseStream {
+private:
+    std::unique_ptr<ResponseStream> inner;
+    ResponseCache& cache;
+    std::string key;
+    std::shared_ptr<CachedResponse> copy;
+
+public:
+    CachingStream(std::unique_ptr<ResponseStream> inner, ResponseCache& cache, const std::string& key,
+                  std::uint64_t version, const std::string& contentType) :
+        inner(std::move(inner)), cache(cache), key(key),
+        copy(std::make_shared<CachedResponse>(CachedResponse{version, contentType, ""})) {}
+
+    bool fill(std::string& output, size_t limit) override {
+        size_t offset = output.size();
+        bool more = inner->fill(output, limit);
+        if (copy) {
+            copy->body.append(output, offset, std::string::npos);
+            if (copy->body.size() > cache.getMaxEntryBytes()) {
+                copy.reset();
+            }
+        }
+        if (!more && copy) {
+            cache.store(key, std::move(copy));
+        }
+        return more;
+    }
+};
+
+// Server-Sent Events feed of new current-temperature readings of one sensor.
+// Every reading is sent as a "reading" event whose data is [epoch,temperature]
+// and whose id names its broadcast sequence, so EventSource clients resume via
+// Last-Event-ID.
+// A comment line goes out when nothing was sent for a while, which keeps
+// proxies and the idle sweep from dropping a quiet subscriber.
+class EventStream : public ResponseStream {
+private:
+    ReadingBroadcaster& broadcaster;
+    int sensor;
+    std::uint64_t sequence;
+    // Readings taken from the broadcaster but not yet written out; the first
+    // has sequence firstSequence.
+    std::vector<Reading> pending;
+    size_t nextPending;
+    std::uint64_t firstSequence;
+    std::chrono::steady_clock::time_point lastSent;
+
+public:
+    EventStream(ReadingBroadcaster& broadcaster, int sensor, std::uint64_t sequence) :
+        broadcaster(broadcaster), sensor(sensor), sequence(sequence), nextPending(0), firstSequence(sequence),
+        lastSent(std::chrono::steady_clock::now()) {}
+
+    bool fill(std::string& output, size_t limit) override {
+        bool sent = false;
+        char buffer[160];
+        while (output.size() < limit) {
+            if (nextPending == pending.size()) {
+                pending.clear();
+                nextPending = 0;
+                broadcaster.readSince(sequence, pending);
+                firstSequence = sequence - pending.size();
+                if (pending.empty()) {
+                    break;
+                }
+            }
+
+            const Reading& reading = pending[nextPending];
+            std::uint64_t id = firstSequence + nextPending++;
+            if (reading.sensor != sensor) {
+                continue;
+            }
+            int length = snprintf(buffer, sizeof(buffer), "event: reading\nid: %s\ndata: [%lld,%.7g]\n\n",
+                                  broadcaster.eventId(id).c_str(), static_cast<long long>(reading.sample.epoch),
+                                  reading.sample.temperature);
+            output.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+            sent = true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (sent) {
+            lastSent = now;
+        } else if (now - lastSent >= std::chrono::seconds(EVENT_HEARTBEAT_SECONDS)) {
+            output += ": keep-alive\n\n";
+            lastSent = now;
+        }
+        return true;
+    }
+
+    void waitForData(std::chrono::milliseconds timeout) override {
+        broadcaster.waitForReading(sequence, timeout);
+    }
+};
+
+
+Server::Server(int port, ConnectionManager& connections, ServerMode mode, unsigned int loopThreads) :
+    serverSocket(INVALID_SOCKET), connections(connections), PORT(port), mode(mode), loopThreads(loopThreads),
+    responseCache(RESPONSE_CACHE_BYTES, MAX_CACHED_RESPONSE_BYTES), startTime(std::time(nullptr)) {
+
+    if (this->loopThreads == 0) {
+        this->loopThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
 
 Server::~Server() {
     if (serverSocket != INVALID_SOCKET) {
@@ -20,6 +293,14 @@ Server::~Server() {
 #endif
 }
 
+void Server::addHotTier(const std::string& table, int sensor, const HotTier& tier) {
+    hotTiers[std::make_pair(table, sensor)] = &tier;
+}
+
+void Server::addBackend(const std::string& table, const StorageBackend& backend) {
+    backends[table] = &backend;
+}
+
 bool Server::initialize() {
 #if defined(WIN32)
     WSADATA wsaData;
@@ -35,6 +316,9 @@ bool Server::initialize() {
         return false;
     }
 
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
     sockaddr_in serverAddr;
     memset(&serverAddr, 0, sizeof(serverAddr));
     serverAddr.sin_family = AF_INET;
@@ -46,7 +330,7 @@ bool Server::initialize() {
         return false;
     }
 
-    if (listen(serverSocket, 5) == SOCKET_ERROR) {
+    if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR) {
         std::cerr << "Listen failed." << std::endl;
         return false;
     }
@@ -54,11 +338,23 @@ bool Server::initialize() {
 }
 
 void Server::run() {
-    if (serverSocket == INVALID_SOCKET || !db) {
+    if (serverSocket == INVALID_SOCKET || !connections.getWriter()) {
         std::cerr << "Server not initialized. Call initialize() first." << std::endl;
         return;
     }
 
+#if defined(WIN32)
+    runThreadPerConnection();
+#else
+    if (mode == ServerMode::EVENT_LOOP) {
+        runEventLoop();
+    } else {
+        runThreadPerConnection();
+    }
+#endif
+}
+
+void Server::runThreadPerConnection() {
     while (true) {
         sockaddr_in clientAddr;
         socklen_t clientAddrLen = sizeof(clientAddr);
@@ -68,138 +364,890 @@ void Server::run() {
             continue;
         }
 
-        std::thread clientThread([this, clientSocket]() { handleClient(clientSocket, db, dbMutex); });
+        std::thread clientThread([this, clientSocket]() { handleClient(clientSocket); });
         clientThread.detach();
     }
 }
 
-void Server::sendResponse(SOCKET clientSocket, const std::string& status, const std::string& body) {
-    std::string response = "HTTP/1.1 " + status + "\r\n"
-                             "Content-Type: text/plain\r\n"
-                             "Connection: close\r\n\r\n" +
-                             body;
-    send(clientSocket, response.c_str(), response.length(), 0);
+#if !defined(WIN32)
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+void Server::runEventLoop() {
+    if (!setNonBlocking(serverSocket)) {
+        std::cerr << "Failed to make listening socket non-blocking." << std::endl;
+        return;
+    }
+
+    std::vector<std::thread> loops;
+    for (unsigned int i = 1; i < loopThreads; ++i) {
+        loops.emplace_back([this]() { eventLoop(); });
+    }
+    eventLoop();
+
+    for (auto& loop : loops) {
+        loop.join();
+    }
+}
+
+// Every loop thread owns its own epoll set and connection table. The listening
+// socket is registered in all of them with EPOLLEXCLUSIVE, so the kernel wakes
+// a single loop per incoming connection and that loop keeps it for its lifetime.
+void Server::eventLoop() {
+    int epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        std::cerr << "epoll_create1 failed." << std::endl;
+        return;
+    }
+
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN | EPOLLEXCLUSIVE;
+    listenEvent.data.ptr = nullptr;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, serverSocket, &listenEvent) < 0) {
+        std::cerr << "Failed to register listening socket." << std::endl;
+        close(epollFd);
+        return;
+    }
+
+    // Woken by the reading broadcaster so that waiting event streams are
+    // filled as soon as a reading is published.
+    int wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event wakeEvent{};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.ptr = &wakeFd;
+    if (wakeFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wakeEvent) < 0) {
+        std::cerr << "Failed to register wake-up descriptor." << std::endl;
+        close(epollFd);
+        return;
+    }
+    int listenerId = getReadingBroadcaster().addListener([wakeFd]() {
+        std::uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    });
+
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+    std::vector<epoll_event> events(MAX_EPOLL_EVENTS);
+    auto lastSweep = std::chrono::steady_clock::now();
+
+    auto closeConnection = [&](Connection* connection) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->socket, nullptr);
+        closesocket(connection->socket);
+        connections.erase(connection);
+    };
+
+    auto serveWaitingStreams = [&]() {
+        std::vector<Connection*> finished;
+        for (auto& entry : connections) {
+            if (entry.second->streamWaiting && !serveConnection(*entry.second)) {
+                finished.push_back(entry.first);
+            }
+        }
+        for (Connection* connection : finished) {
+            closeConnection(connection);
+        }
+    };
+
+    while (true) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed." << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.ptr == nullptr) {
+                while (true) {
+                    SOCKET clientSocket = accept4(serverSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (clientSocket == INVALID_SOCKET) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                            std::cerr << "Failed to accept connection." << std::endl;
+                        }
+                        break;
+                    }
+
+                    auto connection = std::make_unique<Connection>(clientSocket);
+                    epoll_event clientEvent{};
+                    clientEvent.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    clientEvent.data.ptr = connection.get();
+                    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientSocket, &clientEvent) < 0) {
+                        std::cerr << "Failed to register client socket." << std::endl;
+                        closesocket(clientSocket);
+                        continue;
+                    }
+                    connections.emplace(connection.get(), std::move(connection));
+                }
+                continue;
+            }
+            if (events[i].data.ptr == &wakeFd) {
+                std::uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {}
+                serveWaitingStreams();
+                continue;
+            }
+
+            Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+            if ((events[i].events & EPOLLERR) || !serveConnection(*connection)) {
+                closeConnection(connection);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSweep >= std::chrono::seconds(1)) {
+            lastSweep = now;
+            serveWaitingStreams();
+            std::vector<Connection*> idle;
+            for (auto& entry : connections) {
+                if (now - entry.second->lastActivity > std::chrono::seconds(KEEP_ALIVE_TIMEOUT_SECONDS)) {
+                    idle.push_back(entry.first);
+                }
+            }
+            for (Connection* connection : idle) {
+                closeConnection(connection);
+            }
+        }
+    }
+
+    getReadingBroadcaster().removeListener(listenerId);
+    for (auto& entry : connections) {
+        closesocket(entry.second->socket);
+    }
+    close(wakeFd);
+    close(epollFd);
 }
 
-void Server::sendOkResponse(SOCKET clientSocket, const std::string& body) {
-    sendResponse(clientSocket, "200 OK", body);
+// Alternates between draining the socket, producing output and flushing it
+// until the socket would block or there is nothing left to do. Reading stops
+// while input is backed up behind pending output, and produceOutput() stops
+// at the output watermark, so a slow reader throttles its own streaming
+// responses. Returns false once the connection is done.
+bool Server::serveConnection(Connection& connection) {
+    char buffer[4096];
+    auto now = std::chrono::steady_clock::now();
+
+    while (true) {
+        bool progress = false;
+
+        while (!connection.inputClosed && !connection.closeAfterWrite && connection.input.size() < MAX_BUFFERED_INPUT) {
+            ssize_t received = recv(connection.socket, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                connection.lastActivity = now;
+                connection.input.append(buffer, received);
+                progress = true;
+            } else if (received == 0) {
+                connection.inputClosed = true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else {
+                return false;
+            }
+        }
+
+        size_t pendingBefore = connection.pendingOutput();
+        produceOutput(connection);
+        progress = progress || connection.pendingOutput() != pendingBefore;
+
+        while (connection.pendingOutput() > 0) {
+            ssize_t sent = send(connection.socket, connection.output.data() + connection.outputOffset,
+                                connection.pendingOutput(), MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.lastActivity = now;
+                connection.outputOffset += sent;
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        if (!progress) {
+            break;
+        }
+    }
+
+    return !((connection.closeAfterWrite || connection.inputClosed) && !connection.stream);
 }
 
-void Server::sendBadRequest(SOCKET clientSocket, const std::string& message) {
-    sendResponse(clientSocket, "400 Bad Request", message);
+#endif
+
+static std::string toLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
 }
 
-void Server::sendNotFoundResponse(SOCKET clientSocket) {
-    sendResponse(clientSocket, "404 Not Found", "Endpoint not found.");
+// Returns the trimmed value of a request header, matching its name case-insensitively.
+static std::string getHeader(const std::string& request, const std::string& name) {
+    std::istringstream headerStream(request);
+    std::string line;
+    std::getline(headerStream, line);
+    while (std::getline(headerStream, line) && line != "\r") {
+        size_t colonPos = line.find(':');
+        if (colonPos == std::string::npos || toLower(line.substr(0, colonPos)) != name) {
+            continue;
+        }
+        size_t valueStart = line.find_first_not_of(" \t", colonPos + 1);
+        size_t valueEnd = line.find_last_not_of(" \t\r");
+        if (valueStart == std::string::npos || valueEnd < valueStart) {
+            return "";
+        }
+        return line.substr(valueStart, valueEnd - valueStart + 1);
+    }
+    return "";
 }
 
-std::string Server::handleLastRecordRequest(sqlite3* db, const std::string& table) {
-    std::string responseBody = "No data found.";
-    std::string sql = "SELECT * FROM \"" + table + "\" ORDER BY timestamp DESC LIMIT 1";
-    sqlite3_stmt* stmt;
+static bool isKeepAlive(const std::string& request) {
+    std::istringstream requestStream(request);
+    std::string method, path, protocol;
+    requestStream >> method >> path >> protocol;
+
+    std::string connectionHeader = toLower(getHeader(request, "connection"));
+    if (protocol == "HTTP/1.0") {
+        return connectionHeader == "keep-alive";
+    }
+    return connectionHeader != "close";
+}
 
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-        responseBody = "Latest record:\n";
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            std::string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-            double temperature = sqlite3_column_double(stmt, 1);
-            responseBody += "Date: " + date + ", Temperature: " + std::to_string(temperature) + "\n";
+static bool sendAll(SOCKET socket, const char* data, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        int sent = send(socket, data + offset, static_cast<int>(length - offset), MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
         }
-        sqlite3_finalize(stmt);
+        offset += sent;
+    }
+    return true;
+}
+
+Server::Response Server::makeResponse(const std::string& status, const std::string& body) {
+    return Response{status, body, "text/plain", nullptr, "", "", ""};
+}
+
+Server::Response Server::makeOkResponse(const std::string& body) {
+    return makeResponse("200 OK", body);
+}
+
+Server::Response Server::makeBadRequest(const std::string& message) {
+    return makeResponse("400 Bad Request", message);
+}
+
+Server::Response Server::makeNotFoundResponse() {
+    return makeResponse("404 Not Found", "Endpoint not found.");
+}
+
+void Server::writeResponse(Connection& connection, Response response, bool keepAlive) {
+    std::string& output = connection.output;
+    output += "HTTP/1.1 " + response.status + "\r\n"
+              "Content-Type: " + response.contentType + "\r\n";
+    if (!response.etag.empty()) {
+        output += "ETag: " + response.etag + "\r\n"
+                  "Last-Modified: " + response.lastModified + "\r\n"
+                  "Cache-Control: no-cache\r\n";
+    }
+    output += response.headers;
+    if (response.stream) {
+        output += "Transfer-Encoding: chunked\r\n";
+    } else {
+        output += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    }
+    if (keepAlive) {
+        output += "Connection: keep-alive\r\n"
+                  "Keep-Alive: timeout=" + std::to_string(KEEP_ALIVE_TIMEOUT_SECONDS) + "\r\n\r\n";
+    } else {
+        output += "Connection: close\r\n\r\n";
+    }
+
+    if (response.stream) {
+        connection.stream = std::move(response.stream);
+        connection.keepAliveAfterStream = keepAlive;
     } else {
-        responseBody = "Error executing request";
+        output += response.body;
+        connection.closeAfterWrite = !keepAlive;
+    }
+}
+
+Server::Response Server::handleLastRecordRequest(ReadConnection& reader, const std::string& table, int sensor,
+                                                 ResponseFormat format) {
+    CachedStatement statement = reader.statements().get(table, QueryKind::LAST_RECORD);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) {
+        return makeResponse("500 Internal Server Error", "Error executing request");
+    }
+    sqlite3_bind_int(stmt, 1, sensor);
+
+    SampleEncoder encoder(format, "Latest record:\n");
+    Response response = makeOkResponse("");
+    response.contentType = contentTypeFor(format);
+    encoder.begin(response.body);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        encoder.append(response.body, Sample{sqlite3_column_int64(stmt, 0), sqlite3_column_double(stmt, 1)});
     }
-    return responseBody;
+    encoder.end(response.body);
+    return response;
 }
 
-std::string Server::handleRangeRequest(sqlite3* db, const std::string& table, const std::string& start, const std::string& end) {
-    std::string responseBody = "No data found.";
-    std::string sql = "SELECT * FROM \"" + table + "\" WHERE timestamp BETWEEN ? AND ?";
-    sqlite3_stmt* stmt;
+Server::Response Server::handleRangeRequest(ReadConnection reader, const std::string& table, int sensor, std::int64_t start,
+                                            std::int64_t end, ResponseFormat format) {
+    CachedStatement statement = reader.statements().get(table, QueryKind::RANGE);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) {
+        return makeResponse("500 Internal Server Error", "Error executing request");
+    }
+    sqlite3_bind_int(stmt, 1, sensor);
+    sqlite3_bind_int64(stmt, 2, start);
+    sqlite3_bind_int64(stmt, 3, end);
 
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, start.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 2, end.c_str(), -1, SQLITE_TRANSIENT);
+    Response response = makeOkResponse("");
+    response.contentType = contentTypeFor(format);
+    response.stream = std::make_unique<RangeStream>(std::make_unique<StatementCursor>(std::move(reader), std::move(statement)),
+                                                    format);
+    return response;
+}
 
-        responseBody = "Temperature data:\n";
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            std::string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-            double temperature = sqlite3_column_double(stmt, 1);
-            responseBody += "Date: " + date + ", Temperature: " + std::to_string(temperature) + "\n";
+// Answers a range request with about `points` samples. The range's real first
+// and last timestamps are looked up first so that the buckets cover only the
+// data that exists, not the whole requested window.
+Server::Response Server::handleDownsampledRequest(ReadConnection reader, const std::string& table, int sensor,
+                                                  std::int64_t start, std::int64_t end, ResponseFormat format, size_t points,
+                                                  DownsampleMethod method) {
+    std::int64_t firstEpoch = 0, lastEpoch = 0, count = 0;
+    {
+        CachedStatement bounds = reader.statements().get(table, QueryKind::RANGE_BOUNDS);
+        if (!bounds.get()) {
+            return makeResponse("500 Internal Server Error", "Error executing request");
         }
-        sqlite3_finalize(stmt);
+        sqlite3_bind_int(bounds.get(), 1, sensor);
+        sqlite3_bind_int64(bounds.get(), 2, start);
+        sqlite3_bind_int64(bounds.get(), 3, end);
+        if (sqlite3_step(bounds.get()) == SQLITE_ROW) {
+            firstEpoch = sqlite3_column_int64(bounds.get(), 0);
+            lastEpoch = sqlite3_column_int64(bounds.get(), 1);
+            count = sqlite3_column_int64(bounds.get(), 2);
+        }
+    }
+
+    if (count <= static_cast<std::int64_t>(points)) {
+        return handleRangeRequest(std::move(reader), table, sensor, start, end, format);
+    }
+
+    CachedStatement statement = reader.statements().get(table, QueryKind::RANGE);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) {
+        return makeResponse("500 Internal Server Error", "Error executing request");
+    }
+    sqlite3_bind_int(stmt, 1, sensor);
+    sqlite3_bind_int64(stmt, 2, start);
+    sqlite3_bind_int64(stmt, 3, end);
+
+    Response response = makeOkResponse("");
+    response.contentType = contentTypeFor(format);
+    response.stream = std::make_unique<DownsampleStream>(std::make_unique<StatementCursor>(std::move(reader), std::move(statement)),
+                                                         format, Downsampler(method, firstEpoch, lastEpoch, points));
+    return response;
+}
+
+// Same responses as the SQLite handlers, built from a hot tier. Returns a
+// response with an empty status when the tier does not cover the request.
+Server::Response Server::handleHotRequest(const HotTier& tier, bool lastRecord, std::int64_t start, std::int64_t end,
+                                          ResponseFormat format, size_t points, DownsampleMethod method) {
+    Response response = makeOkResponse("");
+    response.contentType = contentTypeFor(format);
+
+    if (lastRecord) {
+        Sample sample;
+        if (!tier.latest(sample)) {
+            response.status.clear();
+            return response;
+        }
+        SampleEncoder encoder(format, "Latest record:\n");
+        encoder.begin(response.body);
+        encoder.append(response.body, sample);
+        encoder.end(response.body);
+        return response;
+    }
+
+    std::vector<Sample> samples;
+    if (!tier.range(start, end, samples)) {
+        response.status.clear();
+        return response;
+    }
+    if (points > 0 && samples.size() > points) {
+        Downsampler downsampler(method, samples.front().epoch, samples.back().epoch, points);
+        response.stream = std::make_unique<DownsampleStream>(std::make_unique<VectorCursor>(std::move(samples)), format,
+                                                             std::move(downsampler));
     } else {
-        responseBody = "Error executing request";
+        response.stream = std::make_unique<RangeStream>(std::make_unique<VectorCursor>(std::move(samples)), format);
     }
-    return responseBody;
+    return response;
 }
 
-void Server::handleClient(SOCKET clientSocket, sqlite3* db, std::mutex& dbMutex) {
-    char buffer[1024];
-    int received = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-    if (received <= 0) {
-        std::cerr << "Failed to receive data from client." << std::endl;
-        closesocket(clientSocket);
-        return;
+// Same responses as the SQLite handlers, read through a storage backend. When
+// a downsampled range holds more samples than requested it is scanned twice,
+// once for its real bounds and once for the samples.
+Server::Response Server::handleBackendRequest(const StorageBackend& backend, int sensor, bool lastRecord, std::int64_t start,
+                                              std::int64_t end, ResponseFormat format, size_t points, DownsampleMethod method) {
+    Response response = makeOkResponse("");
+    response.contentType = contentTypeFor(format);
+
+    if (lastRecord) {
+        SampleEncoder encoder(format, "Latest record:\n");
+        encoder.begin(response.body);
+        Sample sample;
+        if (backend.lastSample(sensor, sample)) {
+            encoder.append(response.body, sample);
+        }
+        encoder.end(response.body);
+        return response;
     }
-    buffer[received] = '\0';
 
-    std::cout << "Received request:\n" << buffer << std::endl;
+    if (points > 0) {
+        Bucket summary = backend.summarize(sensor, start, end + 1);
+        if (summary.count > static_cast<std::int64_t>(points)) {
+            Sample first{}, last{};
+            std::unique_ptr<SampleCursor> bounds = backend.scan(sensor, start, end);
+            bounds->next(first);
+            last = first;
+            for (Sample sample; bounds->next(sample);) {
+                last = sample;
+            }
+            response.stream = std::make_unique<DownsampleStream>(backend.scan(sensor, start, end), format,
+                                                                 Downsampler(method, first.epoch, last.epoch, points));
+            return response;
+        }
+    }
+    response.stream = std::make_unique<RangeStream>(backend.scan(sensor, start, end), format);
+    return response;
+}
 
-    std::istringstream requestStream(buffer);
-    std::string method, path, protocol;
-    requestStream >> method >> path >> protocol;
+Server::Response Server::handleAggregateRequest(ReadConnection reader, const std::string& table, int sensor,
+                                                std::int64_t start, std::int64_t end, ResponseFormat format,
+                                                std::int64_t bucketSeconds) {
+    CachedStatement statement = reader.statements().get(table, QueryKind::RANGE);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) {
+        return makeResponse("500 Internal Server Error", "Error executing request");
+    }
+    sqlite3_bind_int(stmt, 1, sensor);
+    sqlite3_bind_int64(stmt, 2, start);
+    sqlite3_bind_int64(stmt, 3, end);
 
-    if (method == "GET" && path.find("/data?") != std::string::npos) {
-        size_t queryPos = path.find('?');
-        std::string query = path.substr(queryPos + 1);
-        std::string table, start, end, lastRecordFlag;
-
-        std::istringstream queryStream(query);
-        std::string param;
-        while (std::getline(queryStream, param, '&')) {
-            size_t equalsPos = param.find('=');
-            if (equalsPos != std::string::npos) {
-                std::string key = param.substr(0, equalsPos);
-                std::string value = param.substr(equalsPos + 1);
-                if (key == "table") {
-                    table = value;
-                } else if (key == "start") {
-                    start = value;
-                } else if (key == "end") {
-                    end = value;
-                } else if (key == "last") {
-                    lastRecordFlag = value;
-                }
+    Response response = makeOkResponse("");
+    response.contentType = contentTypeFor(format);
+    response.stream = std::make_unique<AggregateStream>(std::make_unique<StatementCursor>(std::move(reader), std::move(statement)),
+                                                        format, bucketSeconds);
+    return response;
+}
+
+void Server::handleClient(SOCKET clientSocket) {
+#if defined(WIN32)
+    DWORD timeout = KEEP_ALIVE_TIMEOUT_SECONDS * 1000;
+#else
+    timeval timeout{KEEP_ALIVE_TIMEOUT_SECONDS, 0};
+#endif
+    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+    Connection connection(clientSocket);
+    char buffer[4096];
+    while (true) {
+        produceOutput(connection);
+        if (connection.pendingOutput() > 0) {
+            if (!sendAll(clientSocket, connection.output.data() + connection.outputOffset, connection.pendingOutput())) {
+                break;
             }
+            connection.outputOffset = connection.output.size();
+            continue;
+        }
+        if (connection.stream) {
+            if (connection.streamWaiting) {
+                connection.stream->waitForData(std::chrono::seconds(1));
+            }
+            continue;
+        }
+        if (connection.closeAfterWrite || connection.inputClosed) {
+            break;
         }
 
-        std::string responseBody;
-        {
-            std::lock_guard<std::mutex> lock(dbMutex);
+        int received = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        connection.input.append(buffer, received);
+    }
+
+    closesocket(clientSocket);
+}
 
-            if (table.empty()) {
-                sendBadRequest(clientSocket, "Missing table name.");
-                return;
+// Fills the connection's output up to OUTPUT_WATERMARK: pulls the next chunk of
+// an active streaming body, or else answers the next complete buffered request.
+// Pipelined requests behind a streaming response wait until it has finished.
+void Server::produceOutput(Connection& connection) {
+    if (connection.outputOffset > 0) {
+        connection.output.erase(0, connection.outputOffset);
+        connection.outputOffset = 0;
+    }
+
+    connection.streamWaiting = false;
+    while (connection.pendingOutput() < OUTPUT_WATERMARK) {
+        if (connection.stream) {
+            std::string chunk;
+            bool more = connection.stream->fill(chunk, STREAM_CHUNK_SIZE);
+            if (more && chunk.empty()) {
+                connection.streamWaiting = true;
+                break;
+            }
+            if (!chunk.empty()) {
+                char chunkSize[20];
+                snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", chunk.size());
+                connection.output += chunkSize;
+                connection.output += chunk;
+                connection.output += "\r\n";
             }
+            if (!more) {
+                connection.output += "0\r\n\r\n";
+                connection.stream.reset();
+                connection.closeAfterWrite = !connection.keepAliveAfterStream;
+            }
+            continue;
+        }
 
-            if (!lastRecordFlag.empty() && lastRecordFlag == "true") {
+        if (connection.closeAfterWrite || !processNextRequest(connection)) {
+            break;
+        }
+    }
+}
 
-                responseBody = handleLastRecordRequest(db, table);
+// Takes one complete request off the front of the connection's input and
+// queues its response. Returns false when no complete request is buffered.
+bool Server::processNextRequest(Connection& connection) {
+    std::string& input = connection.input;
+    size_t headerEnd = input.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) {
+        if (input.size() > MAX_REQUEST_SIZE) {
+            writeResponse(connection, makeBadRequest("Request too large."), false);
+            input.clear();
+            return true;
+        }
+        return false;
+    }
 
-            } else if (!start.empty() && !end.empty()) {
-                responseBody = handleRangeRequest(db, table, start, end);
+    size_t requestEnd = headerEnd + 4;
+    std::string request = input.substr(0, requestEnd);
+    std::string contentLength = getHeader(request, "content-length");
+    if (!contentLength.empty()) {
+        size_t bodyLength = std::strtoul(contentLength.c_str(), nullptr, 10);
+        if (bodyLength > MAX_REQUEST_SIZE) {
+            writeResponse(connection, makeBadRequest("Request too large."), false);
+            input.clear();
+            return true;
+        }
+        if (input.size() - requestEnd < bodyLength) {
+            return false;
+        }
+        requestEnd += bodyLength;
+    }
+    input.erase(0, requestEnd);
 
-            } else {
-                sendBadRequest(clientSocket, "Invalid or missing parameters.");
-                return;
+    writeResponse(connection, processRequest(request), isKeepAlive(request));
+    return true;
+}
+
+// Parses a bucket width such as "300", "300s", "5m", "6h" or "1d" into seconds.
+static std::int64_t parseBucketWidth(const std::string& value) {
+    char* parseEnd = nullptr;
+    long long amount = std::strtoll(value.c_str(), &parseEnd, 10);
+    if (parseEnd == value.c_str() || amount <= 0) {
+        return 0;
+    }
+
+    std::string unit(parseEnd);
+    if (unit.empty() || unit == "s") return amount;
+    if (unit == "m") return amount * 60;
+    if (unit == "h") return amount * 3600;
+    if (unit == "d") return amount * 86400;
+    return 0;
+}
+
+// Decodes %XX escapes and '+' as space; malformed escapes are kept literally.
+static std::string urlDecode(const std::string& value) {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            decoded += ' ';
+        } else if (value[i] == '%' && i + 2 < value.size() && std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            decoded += static_cast<char>(std::strtol(value.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+static std::map<std::string, std::string> parseQuery(const std::string& query) {
+    std::map<std::string, std::string> params;
+    std::istringstream queryStream(query);
+    std::string param;
+    while (std::getline(queryStream, param, '&')) {
+        size_t equalsPos = param.find('=');
+        if (equalsPos != std::string::npos) {
+            params[urlDecode(param.substr(0, equalsPos))] = urlDecode(param.substr(equalsPos + 1));
+        }
+    }
+    return params;
+}
+
+static std::string getParam(const std::map<std::string, std::string>& params, const std::string& key) {
+    auto it = params.find(key);
+    return it != params.end() ? it->second : "";
+}
+
+// Requests without sensor= are for DEFAULT_SENSOR.
+static bool parseSensor(const std::string& value, int& sensor) {
+    if (value.empty()) {
+        sensor = DEFAULT_SENSOR;
+        return true;
+    }
+    char* parseEnd = nullptr;
+    long parsed = std::strtol(value.c_str(), &parseEnd, 10);
+    if (*parseEnd != '\0' || parsed < 0 || parsed > INT_MAX) {
+        return false;
+    }
+    sensor = static_cast<int>(parsed);
+    return true;
+}
+
+Server::Response Server::parseDataQuery(const std::string& request, const std::string& route, const QueryParams& params,
+                                        DataQuery& query) {
+    bool aggregate = route == "/aggregate";
+    std::string start = getParam(params, "start");
+    std::string end = getParam(params, "end");
+    std::string pointsParam = getParam(params, "points");
+
+    query.table = getParam(params, "table");
+    if (query.table.empty()) {
+        return makeBadRequest("Missing table name.");
+    }
+    if (aggregate && (start.empty() || end.empty())) {
+        return makeBadRequest("Invalid or missing parameters.");
+    }
+
+    if (!parseSensor(getParam(params, "sensor"), query.sensor)) {
+        return makeBadRequest("Invalid sensor.");
+    }
+
+    if (!negotiateFormat(getParam(params, "format"), getHeader(request, "accept"), query.format)) {
+        return makeBadRequest("Unsupported format.");
+    }
+
+    query.points = 0;
+    query.method = DownsampleMethod::MIN_MAX;
+    query.bucketSeconds = 0;
+    if (aggregate) {
+        query.bucketSeconds = parseBucketWidth(getParam(params, "bucket"));
+        if (query.bucketSeconds <= 0) {
+            return makeBadRequest("Invalid bucket width.");
+        }
+    } else {
+        if (!pointsParam.empty()) {
+            char* parseEnd = nullptr;
+            query.points = std::strtoul(pointsParam.c_str(), &parseEnd, 10);
+            if (*parseEnd != '\0' || query.points < 2 || query.points > MAX_DOWNSAMPLE_POINTS) {
+                return makeBadRequest("Invalid points value.");
             }
         }
+        if (!parseDownsampleMethod(getParam(params, "downsample"), query.method)) {
+            return makeBadRequest("Unsupported downsample method.");
+        }
+    }
+
+    query.hasRange = !start.empty() && !end.empty();
+    query.startEpoch = 0;
+    query.endEpoch = 0;
+    if (query.hasRange && (!parseLocalTimestamp(start, query.startEpoch) || !parseLocalTimestamp(end, query.endEpoch))) {
+        return makeBadRequest("Invalid start or end time.");
+    }
+
+    query.lastRecord = !aggregate && getParam(params, "last") == "true";
+    if (!query.lastRecord && !query.hasRange) {
+        return makeBadRequest("Invalid or missing parameters.");
+    }
+    return Response();
+}
+
+Server::Response Server::processDataRequest(const DataQuery& query) {
+    auto hot = hotTiers.find(std::make_pair(query.table, query.sensor));
+    if (hot != hotTiers.end()) {
+        Response response = handleHotRequest(*hot->second, query.lastRecord, query.startEpoch, query.endEpoch,
+                                             query.format, query.points, query.method);
+        if (!response.status.empty()) {
+            return response;
+        }
+    }
+
+    auto external = backends.find(query.table);
+    if (external != backends.end()) {
+        return handleBackendRequest(*external->second, query.sensor, query.lastRecord, query.startEpoch, query.endEpoch,
+                                    query.format, query.points, query.method);
+    }
+
+    ReadConnection reader = connections.acquireReader();
+    if (!reader.get()) {
+        return makeResponse("503 Service Unavailable", "Database unavailable.");
+    }
 
-        sendOkResponse(clientSocket, responseBody);
+    if (query.lastRecord) {
+        return handleLastRecordRequest(reader, query.table, query.sensor, query.format);
+    } else if (query.points > 0) {
+        return handleDownsampledRequest(std::move(reader), query.table, query.sensor, query.startEpoch, query.endEpoch,
+                                        query.format, query.points, query.method);
+    }
+    return handleRangeRequest(std::move(reader), query.table, query.sensor, query.startEpoch, query.endEpoch, query.format);
+}
+
+Server::Response Server::processAggregateRequest(const DataQuery& query) {
+    auto external = backends.find(query.table);
+    if (external != backends.end()) {
+        Response response = makeOkResponse("");
+        response.contentType = contentTypeFor(query.format);
+        response.stream = std::make_unique<AggregateStream>(external->second->scan(query.sensor, query.startEpoch, query.endEpoch),
+                                                            query.format, query.bucketSeconds);
+        return response;
+    }
+
+    ReadConnection reader = connections.acquireReader();
+    if (!reader.get()) {
+        return makeResponse("503 Service Unavailable", "Database unavailable.");
+    }
+
+    return handleAggregateRequest(std::move(reader), query.table, query.sensor, query.startEpoch, query.endEpoch,
+                                  query.format, query.bucketSeconds);
+}
+
+static std::string formatHttpDate(std::time_t time) {
+    std::tm utcTime{};
+#if defined(_WIN32)
+    gmtime_s(&utcTime, &time);
+#else
+    gmtime_r(&time, &utcTime);
+#endif
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &utcTime);
+    return buffer;
+}
+
+// Responses under /data and /aggregate depend only on the query and on the
+// contents of one table, so they are cached per table version. The ETag is
+// derived from the key and version rather than from the body, which lets a
+// conditional request be answered without building the response at all.
+// A range that ends before the sensor's newest sample only changes when history
+// is rewritten, so it is tagged with the history counter instead of the version
+// that every insert bumps. The kind of tag is part of the key, so a range that
+// becomes closed does not pick up a body cached under a version number.
+Server::Response Server::processCachedRequest(const std::string& request, const std::string& route, const QueryParams& params) {
+    DataQuery query;
+    Response invalid = parseDataQuery(request, route, params, query);
+    if (!invalid.status.empty()) {
+        return invalid;
+    }
+
+    TableVersion version = connections.getTableVersion(query.table, query.sensor);
+    bool closedRange = !query.lastRecord && query.hasRange && query.endEpoch < version.newest;
+    std::uint64_t tag = closedRange ? version.history : version.version;
+
+    std::string key = route;
+    for (const auto& param : params) {
+        key += '&' + param.first + '=' + param.second;
+    }
+    if (getParam(params, "format").empty()) {
+        key += "|" + getHeader(request, "accept");
+    }
+    key += closedRange ? "|range" : "|table";
+
+    char etag[64];
+    std::snprintf(etag, sizeof(etag), "\"%llx-%llx-%zx\"", static_cast<unsigned long long>(startTime),
+                  static_cast<unsigned long long>(tag), std::hash<std::string>()(key));
+    std::string lastModified = formatHttpDate(closedRange ? version.rewritten : version.modified);
+
+    std::string ifNoneMatch = getHeader(request, "if-none-match");
+    bool notModified = !ifNoneMatch.empty() ? ifNoneMatch == etag || ifNoneMatch == "*"
+                                            : getHeader(request, "if-modified-since") == lastModified;
+    if (notModified) {
+        Response response = makeResponse("304 Not Modified", "");
+        response.etag = etag;
+        response.lastModified = lastModified;
+        return response;
+    }
+
+    std::shared_ptr<const CachedResponse> cached = responseCache.lookup(key, tag);
+    if (cached) {
+        Response response = makeOkResponse(cached->body);
+        response.contentType = cached->contentType;
+        response.etag = etag;
+        response.lastModified = lastModified;
+        return response;
+    }
+
+    Response response = route == "/data" ? processDataRequest(query) : processAggregateRequest(query);
+    if (response.status != "200 OK") {
+        return response;
+    }
+    response.etag = etag;
+    response.lastModified = lastModified;
+    if (response.stream) {
+        response.stream = std::make_unique<CachingStream>(std::move(response.stream), responseCache, key, tag,
+                                                          response.contentType);
     } else {
-        sendNotFoundResponse(clientSocket);
+        responseCache.store(key, std::make_shared<CachedResponse>(CachedResponse{tag, response.contentType, response.body}));
+    }
+    return response;
+}
+
+Server::Response Server::processEventsRequest(const std::string& request, const QueryParams& params) {
+    int sensor;
+    if (!parseSensor(getParam(params, "sensor"), sensor)) {
+        return makeBadRequest("Invalid sensor.");
     }
 
-    closesocket(clientSocket);
-}
\ No newline at end of file
+    ReadingBroadcaster& broadcaster = getReadingBroadcaster();
+    std::string lastEventId = getHeader(request, "last-event-id");
+    std::uint64_t sequence = lastEventId.empty() ? broadcaster.latestSequence()
+                                                 : broadcaster.resumeSequence(lastEventId);
+
+    Response response = makeOkResponse("");
+    response.contentType = "text/event-stream";
+    response.headers = "Cache-Control: no-cache\r\n"
+                       "Access-Control-Allow-Origin: *\r\n";
+    response.stream = std::make_unique<EventStream>(broadcaster, sensor, sequence);
+    return response;
+}
+
+Server::Response Server::processRequest(const std::string& request) {
+    std::cout << "Received request:\n" << request << std::endl;
+
+    std::istringstream requestStream(request);
+    std::string method, path, protocol;
+    requestStream >> method >> path >> protocol;
+
+    size_t queryPos = path.find('?');
+    std::string route = path.substr(0, queryPos);
+    QueryParams params = queryPos != std::string::npos ? parseQuery(path.substr(queryPos + 1)) : QueryParams();
+
+    if (method == "GET" && (route == "/data" || route == "/aggregate")) {
+        return processCachedRequest(request, route, params);
+    } else if (method == "GET" && route == "/events") {
+        return processEventsRequest(request, params);
+    }
+
+    return makeNotFoundResponse();
+}
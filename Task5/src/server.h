@@ -2,7 +2,11 @@
 #define SERVER_H
 
 #include <string>
+#include <map>
 #include <mutex>
+#include <memory>
+#include <ctime>
+#include <chrono>
 
 #if defined(WIN32)
 #   include <winsock2.h>
@@ -17,33 +21,125 @@
 #   define SOCKET int
 #   define INVALID_SOCKET -1
 #   define SOCKET_ERROR -1
+#   define closesocket close
 #endif
 
 #include <sqlite3.h>
+#include "connection_manager.h"
+#include "response_format.h"
+#include "downsampler.h"
+#include "response_cache.h"
+#include "reading_broadcaster.h"
+#include "hot_tier.h"
+#include "storage_backend.h"
+
+// Produces a response body incrementally. fill() appends roughly up to limit
+// bytes to output and returns false once the body is complete. A stream that
+// appends nothing but returns true is waiting for data that does not exist
+// yet; it is filled again after waitForData() returns or, in the event loop,
+// when its source wakes the loop.
+class ResponseStream {
+public:
+    virtual ~ResponseStream() = default;
+    virtual bool fill(std::string& output, size_t limit) = 0;
+    virtual void waitForData(std::chrono::milliseconds /*timeout*/) {}
+};
+
+enum class ServerMode {
+    THREAD_PER_CONNECTION,
+    EVENT_LOOP
+};
 
 class Server {
 private:
+    struct Connection;
+
+    typedef std::map<std::string, std::string> QueryParams;
+
+    struct Response {
+        std::string status;
+        std::string body;
+        std::string contentType;
+        std::unique_ptr<ResponseStream> stream;
+        std::string etag;
+        std::string lastModified;
+        std::string headers;
+    };
+
+    // Parameters of a /data or /aggregate request that passed validation.
+    struct DataQuery {
+        std::string table;
+        int sensor;
+        ResponseFormat format;
+        bool lastRecord;
+        bool hasRange;
+        std::int64_t startEpoch;
+        std::int64_t endEpoch;
+        size_t points;
+        DownsampleMethod method;
+        std::int64_t bucketSeconds;
+    };
+
     SOCKET serverSocket;
-    sqlite3* db;
-    std::mutex dbMutex;
+    ConnectionManager& connections;
     const int PORT;
     const std::string DB_PATH;
+    ServerMode mode;
+    unsigned int loopThreads;
+    ResponseCache responseCache;
+    std::time_t startTime;
+    std::map<std::pair<std::string, int>, const HotTier*> hotTiers;
+    std::map<std::string, const StorageBackend*> backends;
+
+    Response makeResponse(const std::string& status, const std::string& body);
+    Response makeOkResponse(const std::string& body);
+    Response makeBadRequest(const std::string& message);
+    Response makeNotFoundResponse();
+    void writeResponse(Connection& connection, Response response, bool keepAlive);
 
-    void sendResponse(SOCKET clientSocket, const std::string& status, const std::string& body);
-    void sendOkResponse(SOCKET clientSocket, const std::string& body);
-    void sendBadRequest(SOCKET clientSocket, const std::string& message);
-    void sendNotFoundResponse(SOCKET clientSocket);
+    Response handleLastRecordRequest(ReadConnection& reader, const std::string& table, int sensor, ResponseFormat format);
+    Response handleRangeRequest(ReadConnection reader, const std::string& table, int sensor, std::int64_t start,
+                                std::int64_t end, ResponseFormat format);
+    Response handleDownsampledRequest(ReadConnection reader, const std::string& table, int sensor, std::int64_t start,
+                                      std::int64_t end, ResponseFormat format, size_t points, DownsampleMethod method);
+    Response handleHotRequest(const HotTier& tier, bool lastRecord, std::int64_t start, std::int64_t end,
+                              ResponseFormat format, size_t points, DownsampleMethod method);
+    Response handleBackendRequest(const StorageBackend& backend, int sensor, bool lastRecord, std::int64_t start,
+                                  std::int64_t end, ResponseFormat format, size_t points, DownsampleMethod method);
+    Response handleAggregateRequest(ReadConnection reader, const std::string& table, int sensor, std::int64_t start,
+                                    std::int64_t end, ResponseFormat format, std::int64_t bucketSeconds);
+    // Returns a response with an empty status if the parameters are valid.
+    Response parseDataQuery(const std::string& request, const std::string& route, const QueryParams& params,
+                            DataQuery& query);
+    Response processDataRequest(const DataQuery& query);
+    Response processAggregateRequest(const DataQuery& query);
+    Response processCachedRequest(const std::string& request, const std::string& route, const QueryParams& params);
+    Response processEventsRequest(const std::string& request, const QueryParams& params);
+    Response processRequest(const std::string& request);
+    bool processNextRequest(Connection& connection);
+    void produceOutput(Connection& connection);
+    void handleClient(SOCKET clientSocket);
 
-    std::string handleLastRecordRequest(sqlite3* db, const std::string& table);
-    std::string handleRangeRequest(sqlite3* db, const std::string& table, const std::string& start, const std::string& end);
-    void handleClient(SOCKET clientSocket, sqlite3* db, std::mutex& dbMutex);
+    void runThreadPerConnection();
+#if !defined(WIN32)
+    void runEventLoop();
+    void eventLoop();
+    bool serveConnection(Connection& connection);
+#endif
 
 public:
-    Server(int port, sqlite3* db);
+    Server(int port, ConnectionManager& connections, ServerMode mode = ServerMode::EVENT_LOOP, unsigned int loopThreads = 0);
     ~Server();
 
+    // Lets /data answer latest-value and recent-range queries for one sensor
+    // of table from memory. Register tiers before run().
+    void addHotTier(const std::string& table, int sensor, const HotTier& tier);
+    // Serves /data and /aggregate for table from a storage backend other than
+    // the server's own database. Register backends before run().
+    void addBackend(const std::string& table, const StorageBackend& backend);
+
     bool initialize();
     void run();
 };
 
-#endif
\ No newline at end of file
+#endif
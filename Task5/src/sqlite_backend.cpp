@@ -0,0 +1,187 @@
+#include "sqlite_backend.h"
+#include <iostream>
+
+SqliteBackend::SqliteBackend(const std::string& table, ConnectionManager& connections, PartitionScheme scheme) :
+    table(table), connections(connections), partitions(table, scheme) {}
+
+bool SqliteBackend::open() {
+    sqlite3* db = connections.getWriter();
+    return db && partitions.initialize(db);
+}
+
+bool SqliteBackend::append(int sensor, const Sample& sample) {
+    sqlite3* db = connections.getWriter();
+    if (!db) return false;
+
+    CachedStatement statement = connections.getWriterStatements().get(partitions.partitionFor(db, sample.epoch), QueryKind::INSERT);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) return false;
+
+    sqlite3_bind_int(stmt, 1, sensor);
+    sqlite3_bind_int64(stmt, 2, sample.epoch);
+    sqlite3_bind_double(stmt, 3, sample.temperature);
+
+    connections.beginWrite();
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE && rc != SQLITE_OK && rc != SQLITE_ROW) {
+        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+    }
+    connections.endWrite();
+    return rc == SQLITE_DONE;
+}
+
+size_t SqliteBackend::appendBatch(int sensor, const std::vector<Sample>& samples) {
+    sqlite3* db = connections.getWriter();
+    if (!db || samples.empty()) return 0;
+
+    size_t stored = 0;
+    connections.beginBulkWrite();
+    std::string target;
+    CachedStatement statement(nullptr);
+    for (const Sample& sample : samples) {
+        std::string partition = partitions.partitionFor(db, sample.epoch);
+        if (partition != target || !statement.get()) {
+            target = partition;
+            statement = connections.getWriterStatements().get(target, QueryKind::INSERT);
+        }
+        sqlite3_stmt* stmt = statement.get();
+        if (!stmt) continue;
+        sqlite3_bind_int(stmt, 1, sensor);
+        sqlite3_bind_int64(stmt, 2, sample.epoch);
+        sqlite3_bind_double(stmt, 3, sample.temperature);
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE) {
+            ++stored;
+        } else {
+            std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+        }
+        sqlite3_reset(stmt);
+    }
+    connections.endBulkWrite();
+    return stored;
+}
+
+std::unique_ptr<SampleCursor> SqliteBackend::scan(int sensor, std::int64_t start, std::int64_t end) const {
+    ReadConnection reader = connections.acquireReader();
+    if (!reader.get()) {
+        return std::make_unique<VectorCursor>(std::vector<Sample>());
+    }
+
+    CachedStatement statement = reader.statements().get(table, QueryKind::RANGE);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) {
+        return std::make_unique<VectorCursor>(std::vector<Sample>());
+    }
+    sqlite3_bind_int(stmt, 1, sensor);
+    sqlite3_bind_int64(stmt, 2, start);
+    sqlite3_bind_int64(stmt, 3, end);
+    return std::make_unique<StatementCursor>(std::move(reader), std::move(statement));
+}
+
+Bucket SqliteBackend::summarize(int sensor, std::int64_t start, std::int64_t end) const {
+    Bucket bucket{start, 0.0, 0.0, 0.0, 0};
+
+    ReadConnection reader = connections.acquireReader();
+    sqlite3* db = reader.get();
+    if (!db) return bucket;
+
+    CachedStatement statement = reader.statements().get(table, QueryKind::SUMMARY);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) return bucket;
+
+    sqlite3_bind_int(stmt, 1, sensor);
+    sqlite3_bind_int64(stmt, 2, start);
+    sqlite3_bind_int64(stmt, 3, end);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        bucket.count = sqlite3_column_int64(stmt, 0);
+        bucket.sum = sqlite3_column_double(stmt, 1);
+        bucket.min = sqlite3_column_double(stmt, 2);
+        bucket.max = sqlite3_column_double(stmt, 3);
+    } else if (rc != SQLITE_DONE) {
+        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+    }
+    return bucket;
+}
+
+// FIRST_DATE and LAST_RECORD both select (epoch, temperature) of one row.
+static bool readEdgeSample(ConnectionManager& connections, const std::string& table, QueryKind kind, int sensor,
+                           Sample& sample) {
+    ReadConnection reader = connections.acquireReader();
+    sqlite3* db = reader.get();
+    if (!db) return false;
+
+    CachedStatement statement = reader.statements().get(table, kind);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) return false;
+    sqlite3_bind_int(stmt, 1, sensor);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        sample = Sample{sqlite3_column_int64(stmt, 0), sqlite3_column_double(stmt, 1)};
+        return true;
+    }
+    if (rc != SQLITE_DONE) {
+        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+    }
+    return false;
+}
+
+bool SqliteBackend::firstSample(int sensor, Sample& sample) const {
+    return readEdgeSample(connections, table, QueryKind::FIRST_DATE, sensor, sample);
+}
+
+bool SqliteBackend::lastSample(int sensor, Sample& sample) const {
+    return readEdgeSample(connections, table, QueryKind::LAST_RECORD, sensor, sample);
+}
+
+// Partitions go whole once they end at or before cutoff.
+std::int64_t SqliteBackend::dropBoundary(std::int64_t cutoff) const {
+    return partitions.isPartitioned() ? partitions.startOf(cutoff) : cutoff;
+}
+
+size_t SqliteBackend::dropBefore(std::int64_t cutoff) {
+    sqlite3* db = connections.getWriter();
+    if (!db) return 0;
+
+    if (partitions.isPartitioned()) {
+        connections.beginWrite();
+        std::vector<std::string> dropped = partitions.dropBefore(db, cutoff);
+        for (const std::string& name : dropped) {
+            connections.getWriterStatements().forget(name);
+        }
+        if (!dropped.empty()) {
+            connections.markChanged(table);
+        }
+        connections.endWrite();
+        return dropped.size();
+    }
+
+    CachedStatement statement = connections.getWriterStatements().get(table, QueryKind::REMOVE_OUTDATED);
+    sqlite3_stmt* stmt = statement.get();
+    if (!stmt) return 0;
+
+    sqlite3_bind_int64(stmt, 1, cutoff);
+
+    connections.beginWrite();
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+        std::cerr << "SQL execute error: " << sqlite3_errmsg(db) << std::endl;
+    }
+    size_t removed = static_cast<size_t>(sqlite3_changes(db));
+    if (removed > 0) {
+        connections.markChanged(table);
+    }
+    connections.endWrite();
+    return removed;
+}
+
+std::unique_ptr<StorageBackend> makeStorageBackend(StorageEngine engine, const std::string& table,
+                                                   ConnectionManager& connections, PartitionScheme scheme) {
+    if (engine == StorageEngine::SQLITE) {
+        return std::make_unique<SqliteBackend>(table, connections, scheme);
+    }
+    std::int64_t segmentSeconds = scheme == PartitionScheme::MONTHLY ? 30 * 24 * 3600 : 24 * 3600;
+    return makeFileBackend(engine, table, segmentSeconds);
+}
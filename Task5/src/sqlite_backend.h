@@ -0,0 +1,44 @@
+#ifndef SQLITE_BACKEND_H
+#define SQLITE_BACKEND_H
+
+#include "storage_backend.h"
+#include "connection_manager.h"
+#include "partitions.h"
+
+// A measurement table in the connection manager's database. Writes go through
+// the writer connection and its group commit, reads through the read pool, and
+// each write marks the table changed for the response cache.
+class SqliteBackend : public StorageBackend {
+private:
+    std::string table;
+    ConnectionManager& connections;
+    PartitionedTable partitions;
+
+public:
+    SqliteBackend(const std::string& table, ConnectionManager& connections, PartitionScheme scheme);
+
+    bool open() override;
+
+    bool append(int sensor, const Sample& sample) override;
+    size_t appendBatch(int sensor, const std::vector<Sample>& samples) override;
+
+    std::unique_ptr<SampleCursor> scan(int sensor, std::int64_t start, std::int64_t end) const override;
+    Bucket summarize(int sensor, std::int64_t start, std::int64_t end) const override;
+    bool firstSample(int sensor, Sample& sample) const override;
+    bool lastSample(int sensor, Sample& sample) const override;
+
+    // Drops whole partitions when the table is partitioned, rows otherwise.
+    size_t dropBefore(std::int64_t cutoff) override;
+    std::int64_t dropBoundary(std::int64_t cutoff) const override;
+
+    bool replacesSamples() const override { return true; }
+};
+
+// The backend for table. SQLite keeps it in table (partitioned by scheme) of
+// the connections' database; the file engines use the directory
+// <table>.<engine> with segments as long as the scheme's partitions, or a day.
+std::unique_ptr<StorageBackend> makeStorageBackend(StorageEngine engine, const std::string& table,
+                                                   ConnectionManager& connections,
+                                                   PartitionScheme scheme = PartitionScheme::NONE);
+
+#endif
@@ -0,0 +1,85 @@
+#include "statement_cache.h"
+#include <iostream>
+
+// Every query except REMOVE_OUTDATED is for one sensor, bound as parameter 1.
+std::string buildQuery(const std::string& table, QueryKind kind) {
+    std::string quoted = "\"" + table + "\"";
+    switch (kind) {
+        case QueryKind::INSERT:
+            return "INSERT OR REPLACE INTO " + quoted + " (sensor_id, epoch, temperature) VALUES (?, ?, ?)";
+        case QueryKind::AVERAGE:
+            return "SELECT AVG(temperature) FROM " + quoted + " WHERE sensor_id = ? AND epoch >= ? AND epoch < ?";
+        case QueryKind::FIRST_DATE:
+            return "SELECT epoch, temperature FROM " + quoted + " WHERE sensor_id = ? ORDER BY epoch LIMIT 1";
+        case QueryKind::LAST_DATE:
+            return "SELECT epoch FROM " + quoted + " WHERE sensor_id = ? ORDER BY epoch DESC LIMIT 1";
+        case QueryKind::REMOVE_OUTDATED:
+            return "DELETE FROM " + quoted + " WHERE epoch < ?";
+        case QueryKind::LAST_RECORD:
+            return "SELECT epoch, temperature FROM " + quoted + " WHERE sensor_id = ? ORDER BY epoch DESC LIMIT 1";
+        case QueryKind::RANGE:
+            return "SELECT epoch, temperature FROM " + quoted + " WHERE sensor_id = ? AND epoch BETWEEN ? AND ? ORDER BY epoch";
+        case QueryKind::RANGE_BOUNDS:
+            return "SELECT MIN(epoch), MAX(epoch), COUNT(*) FROM " + quoted + " WHERE sensor_id = ? AND epoch BETWEEN ? AND ?";
+        case QueryKind::SUMMARY:
+            return "SELECT COUNT(*), TOTAL(temperature), MIN(temperature), MAX(temperature) FROM " + quoted +
+                   " WHERE sensor_id = ? AND epoch >= ? AND epoch < ?";
+    }
+    return "";
+}
+
+CachedStatement::~CachedStatement() {
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+}
+
+CachedStatement& CachedStatement::operator=(CachedStatement&& other) noexcept {
+    if (this != &other) {
+        if (stmt) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        stmt = other.stmt;
+        other.stmt = nullptr;
+    }
+    return *this;
+}
+
+StatementCache::StatementCache(sqlite3* db) : db(db) {}
+
+StatementCache::~StatementCache() {
+    for (auto& entry : statements) {
+        sqlite3_finalize(entry.second);
+    }
+}
+
+CachedStatement StatementCache::get(const std::string& table, QueryKind kind) {
+    auto key = std::make_pair(table, kind);
+    auto it = statements.find(key);
+    if (it != statements.end()) {
+        return CachedStatement(it->second);
+    }
+
+    std::string sql = buildQuery(table, kind);
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+        return CachedStatement(nullptr);
+    }
+
+    statements.emplace(key, stmt);
+    return CachedStatement(stmt);
+}
+
+void StatementCache::forget(const std::string& table) {
+    for (auto it = statements.begin(); it != statements.end();) {
+        if (it->first.first == table) {
+            sqlite3_finalize(it->second);
+            it = statements.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
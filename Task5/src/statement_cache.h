@@ -0,0 +1,60 @@
+#ifndef STATEMENT_CACHE_H
+#define STATEMENT_CACHE_H
+
+#include <string>
+#include <map>
+#include <utility>
+#include <sqlite3.h>
+
+enum class QueryKind {
+    INSERT,
+    AVERAGE,
+    FIRST_DATE,
+    LAST_DATE,
+    REMOVE_OUTDATED,
+    LAST_RECORD,
+    RANGE,
+    RANGE_BOUNDS,
+    SUMMARY
+};
+
+// A statement borrowed from a StatementCache. It is reset and its bindings
+// cleared on destruction, which also ends the read it may still hold open.
+class CachedStatement {
+private:
+    sqlite3_stmt* stmt;
+
+public:
+    explicit CachedStatement(sqlite3_stmt* stmt) : stmt(stmt) {}
+    CachedStatement(CachedStatement&& other) noexcept : stmt(other.stmt) { other.stmt = nullptr; }
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+    CachedStatement& operator=(CachedStatement&& other) noexcept;
+    ~CachedStatement();
+
+    sqlite3_stmt* get() const { return stmt; }
+};
+
+// Prepared statements of one connection, keyed by table and query kind. Each
+// statement is compiled once and then reused through reset/rebind. Like the
+// connection itself, a cache must only be used by one thread at a time.
+class StatementCache {
+private:
+    sqlite3* db;
+    std::map<std::pair<std::string, QueryKind>, sqlite3_stmt*> statements;
+
+public:
+    explicit StatementCache(sqlite3* db);
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+    ~StatementCache();
+
+    // Returns a null statement if the query cannot be prepared.
+    CachedStatement get(const std::string& table, QueryKind kind);
+    // Finalizes the statements of a table that no longer exists.
+    void forget(const std::string& table);
+};
+
+std::string buildQuery(const std::string& table, QueryKind kind);
+
+#endif
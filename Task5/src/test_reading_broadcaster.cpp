@@ -0,0 +1,57 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "reading_broadcaster.h"
+
+// Checks how subscribers resume from a Last-Event-ID, in particular that an
+// id kept from before a server restart does not stall the feed.
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        ++failures;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+static void publishReadings(ReadingBroadcaster& broadcaster, int count) {
+    for (int i = 0; i < count; ++i) {
+        broadcaster.publish(Reading{1, Sample{1700000000 + i, 20.0}});
+    }
+}
+
+int main() {
+    ReadingBroadcaster before;
+    publishReadings(before, 5000);
+    std::string oldId = before.eventId(4999);
+
+    // The restarted server has only sent a few readings so far.
+    ReadingBroadcaster after;
+    publishReadings(after, 3);
+    std::uint64_t latest = after.latestSequence();
+
+    std::uint64_t sequence = after.resumeSequence(oldId);
+    expect(sequence == latest, "id from another instance resumes at the latest reading");
+    std::vector<Reading> readings;
+    after.readSince(sequence, readings);
+    expect(readings.size() == 1, "id from another instance delivers the latest reading");
+
+    expect(after.resumeSequence(after.eventId(1)) == 2, "id of this instance resumes after it");
+    expect(after.resumeSequence(after.eventId(3)) == 4, "id of the newest reading waits for the next one");
+    expect(after.resumeSequence(after.eventId(4000)) == latest, "id past the newest reading is clamped");
+    expect(after.resumeSequence("4999") == latest, "id without an instance is ignored");
+    expect(after.resumeSequence("garbage") == latest, "malformed id is ignored");
+
+    // Even without going through resumeSequence, a future sequence must not
+    // wait for the counter to catch up.
+    sequence = 4000;
+    readings.clear();
+    after.readSince(sequence, readings);
+    publishReadings(after, 1);
+    after.readSince(sequence, readings);
+    expect(readings.size() == 1, "future sequence is clamped by readSince");
+
+    std::cout << (failures == 0 ? "All checks passed" : "Some checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -18,9 +18,11 @@
 #include <QLineEdit>
 #include <QHBoxLayout>
 #include <QTimer>
+#include <QtEndian>
+#include <cstring>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), repliesPending(0) {
+    : QMainWindow(parent), repliesPending(0), eventsReply(nullptr) {
 
     setWindowTitle("Temperature manager");
 
@@ -94,16 +96,15 @@ MainWindow::MainWindow(QWidget *parent)
     connect(updateButton, &QToolButton::clicked, this, &MainWindow::sendRequest);
     connect(multiRequestButton, &QPushButton::clicked, this, &MainWindow::sendRequestsToGraphs);
 
-    timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &MainWindow::sendRequest);
-
     sendRequest();
-    timer->start(5000);
+    subscribeToEvents();
 }
 
 MainWindow::~MainWindow(){
-    timer->stop();
-    delete timer;
+    if (eventsReply) {
+        eventsReply->disconnect(this);
+        eventsReply->abort();
+    }
 }
 
 
@@ -142,6 +143,8 @@ void MainWindow::sendRequestsToGraphs() {
         query.addQueryItem("start", startDate.toString("yyyy-MM-dd HH:mm:ss"));
         query.addQueryItem("end", endDate.toString("yyyy-MM-dd HH:mm:ss"));
         query.addQueryItem("table", table);
+        query.addQueryItem("format", "binary");
+        query.addQueryItem("points", QString::number(qMax(200, chartWidget->width())));
         url.setQuery(query);
 
         QNetworkRequest request(url);
@@ -164,24 +167,26 @@ void MainWindow::sendRequestsToGraphs() {
 
 void MainWindow::handleReplyToGraphs(QNetworkReply *reply, int index) {
     if (reply->error() == QNetworkReply::NoError) {
-        QString response = reply->readAll();
+        // Packed little-endian records: int64 epoch seconds + float32 temperature.
+        const int recordSize = 12;
+        QByteArray response = reply->readAll();
+        const uchar *data = reinterpret_cast<const uchar *>(response.constData());
+        int count = response.size() / recordSize;
+
         QVector<QDateTime> x;
         QVector<double> y;
-
-        QStringList lines = response.split('\n', QString::SkipEmptyParts);
-
-        for (const QString &line : lines) {
-            QRegularExpression regex(R"(Date:\s*([\d\- :]+),\s*Temperature:\s*([\d\.\-]+))");
-            QRegularExpressionMatch match = regex.match(line);
-            if (match.hasMatch()) {
-                QDateTime dateTime = QDateTime::fromString(match.captured(1), "yyyy-MM-dd HH:mm:ss");
-                if (dateTime.isValid()) {
-                    x.append(dateTime);
-                    y.append(match.captured(2).toDouble());
-                } else {
-                    qDebug() << "Invalid date format: " << match.captured(1);
-                }
-            }
+        x.reserve(count);
+        y.reserve(count);
+
+        for (int i = 0; i < count; ++i) {
+            const uchar *record = data + i * recordSize;
+            qint64 epoch = qFromLittleEndian<qint64>(record);
+            quint32 temperatureBits = qFromLittleEndian<quint32>(record + 8);
+            float temperature;
+            std::memcpy(&temperature, &temperatureBits, sizeof(temperature));
+
+            x.append(QDateTime::fromSecsSinceEpoch(epoch));
+            y.append(temperature);
         }
         repliesData[index] = {x, y};
     } else {
@@ -264,6 +269,7 @@ void MainWindow::sendRequest() {
     QUrlQuery query;
     query.addQueryItem("table", "data_current");
     query.addQueryItem("last", "true");
+    query.addQueryItem("format", "json");
     url.setQuery(query);
 
     QNetworkRequest request(url);
@@ -283,14 +289,10 @@ void MainWindow::sendRequest() {
 
 void MainWindow::handleReplyToLast(QNetworkReply *reply) {
     if (reply->error() == QNetworkReply::NoError) {
-        QByteArray response = reply->readAll();
-        QString responseText = QString::fromUtf8(response);
-
-        QRegularExpression regex(R"(\bTemperature:\s*(-?\d+(\.\d+)?))");
-        QRegularExpressionMatch match = regex.match(responseText);
+        QJsonArray records = QJsonDocument::fromJson(reply->readAll()).array();
 
-        if (match.hasMatch()) {
-            QString temperature = match.captured(1);
+        if (!records.isEmpty()) {
+            double temperature = records.first().toArray().at(1).toDouble();
             resultLabel->setText(QString("Temperature: %1").arg(temperature));
         } else {
             resultLabel->setText("Temperature not found in response.");
@@ -301,3 +303,46 @@ void MainWindow::handleReplyToLast(QNetworkReply *reply) {
     }
     reply->deleteLater();
 }
+
+// New readings are pushed by the server as Server-Sent Events; the connection
+// is reopened a second later whenever it drops, resuming after the last event.
+void MainWindow::subscribeToEvents() {
+    QNetworkRequest request(QUrl("http://mysitehost:8080/events"));
+    request.setRawHeader("Accept", "text/event-stream");
+    if (!lastEventId.isEmpty()) {
+        request.setRawHeader("Last-Event-ID", lastEventId);
+    }
+
+    eventsBuffer.clear();
+    eventsReply = networkManager->get(request);
+    connect(eventsReply, &QNetworkReply::readyRead, this, &MainWindow::handleEvents);
+    connect(eventsReply, &QNetworkReply::finished, this, [this]() {
+        eventsReply->deleteLater();
+        eventsReply = nullptr;
+        QTimer::singleShot(1000, this, &MainWindow::subscribeToEvents);
+    });
+}
+
+void MainWindow::handleEvents() {
+    eventsBuffer += eventsReply->readAll();
+
+    int eventEnd;
+    while ((eventEnd = eventsBuffer.indexOf("\n\n")) >= 0) {
+        QByteArray event = eventsBuffer.left(eventEnd);
+        eventsBuffer.remove(0, eventEnd + 2);
+
+        QByteArray data;
+        for (const QByteArray &line : event.split('\n')) {
+            if (line.startsWith("id: ")) {
+                lastEventId = line.mid(4);
+            } else if (line.startsWith("data: ")) {
+                data = line.mid(6);
+            }
+        }
+
+        QJsonArray reading = QJsonDocument::fromJson(data).array();
+        if (reading.size() == 2) {
+            resultLabel->setText(QString("Temperature: %1").arg(reading.at(1).toDouble()));
+        }
+    }
+}
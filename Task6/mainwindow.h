@@ -33,6 +33,8 @@ private slots:
     void sendRequestsToGraphs();
     void handleReplyToLast(QNetworkReply *reply);
     void handleReplyToGraphs(QNetworkReply *reply, int index);
+    void subscribeToEvents();
+    void handleEvents();
 
 private:
     QLineEdit *startDateEdit;
@@ -55,7 +57,9 @@ private:
     };
     QVector<ReplyData> repliesData;
 
-    QTimer *timer;
+    QNetworkReply *eventsReply;
+    QByteArray eventsBuffer;
+    QByteArray lastEventId;
 };
 
 #endif
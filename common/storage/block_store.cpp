@@ -0,0 +1,414 @@
+#include "block_store.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+
+#define BLOCK_SAMPLES 1024
+#define SEGMENT_SECONDS 86400
+#define HEADER_BYTES 40
+
+static void encodeHeader(const BlockInfo& info, char* header) {
+    std::memcpy(header, &info.payloadBytes, 4);
+    std::memcpy(header + 4, &info.count, 4);
+    std::memcpy(header + 8, &info.firstEpoch, 8);
+    std::memcpy(header + 16, &info.lastEpoch, 8);
+    std::memcpy(header + 24, &info.min, 4);
+    std::memcpy(header + 28, &info.max, 4);
+    std::memcpy(header + 32, &info.sum, 8);
+}
+
+static void decodeHeader(const char* header, BlockInfo& info) {
+    std::memcpy(&info.payloadBytes, header, 4);
+    std::memcpy(&info.count, header + 4, 4);
+    std::memcpy(&info.firstEpoch, header + 8, 8);
+    std::memcpy(&info.lastEpoch, header + 16, 8);
+    std::memcpy(&info.min, header + 24, 4);
+    std::memcpy(&info.max, header + 28, 4);
+    std::memcpy(&info.sum, header + 32, 8);
+}
+
+static bool readPayload(std::ifstream& file, const BlockInfo& info, std::string& payload) {
+    payload.resize(info.payloadBytes);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(info.offset + HEADER_BYTES));
+    return static_cast<bool>(file.read(&payload[0], info.payloadBytes));
+}
+
+static std::int64_t segmentStart(std::int64_t epoch) {
+    return epoch - ((epoch % SEGMENT_SECONDS) + SEGMENT_SECONDS) % SEGMENT_SECONDS;
+}
+
+// Decodes a snapshot of blocks taken under the store's lock. Sealed blocks
+// are read from their files as the cursor reaches them; the open block's
+// bytes are copied up front because the writer keeps rewriting it.
+class BlockCursor : public SampleCursor {
+private:
+    struct Part {
+        std::string path;
+        BlockInfo info;
+        bool copied;
+        std::string bytes;
+    };
+
+    std::vector<Part> parts;
+    std::int64_t start;
+    std::int64_t end;
+    size_t nextPart;
+    std::string openPath;
+    std::ifstream file;
+    std::string payload;
+    std::unique_ptr<GorillaDecoder> decoder;
+    std::uint32_t remaining;
+    bool finished;
+
+    bool loadNextPart() {
+        while (nextPart < parts.size()) {
+            Part& part = parts[nextPart++];
+            if (part.copied) {
+                payload.swap(part.bytes);
+            } else {
+                if (openPath != part.path) {
+                    file.close();
+                    file.clear();
+                    file.open(part.path, std::ios::binary);
+                    openPath = part.path;
+                }
+                if (!file || !readPayload(file, part.info, payload)) {
+                    continue;
+                }
+            }
+            decoder = std::make_unique<GorillaDecoder>(payload.data(), payload.size());
+            remaining = part.info.count;
+            return true;
+        }
+        return false;
+    }
+
+public:
+    BlockCursor(const BlockStore& store, int sensor, std::int64_t start, std::int64_t end) :
+        start(start), end(end), nextPart(0), remaining(0), finished(false) {
+        std::shared_lock<std::shared_mutex> lock(store.mutex);
+        auto it = store.series.find(sensor);
+        if (it == store.series.end()) {
+            return;
+        }
+        const BlockStore::Series& series = it->second;
+        for (size_t s = 0; s < series.segments.size(); ++s) {
+            const BlockStore::Segment& segment = series.segments[s];
+            for (size_t b = 0; b < segment.blocks.size(); ++b) {
+                const BlockInfo& info = segment.blocks[b];
+                if (info.lastEpoch < start || info.firstEpoch > end) {
+                    continue;
+                }
+                bool isOpen = s + 1 == series.segments.size() && b + 1 == segment.blocks.size() && series.open.size() > 0;
+                parts.push_back(Part{segment.path, info, isOpen, isOpen ? series.open.data() : std::string()});
+            }
+        }
+    }
+
+    bool next(Sample& sample) override {
+        while (!finished) {
+            std::int64_t epoch;
+            float value;
+            if (remaining == 0 || !decoder->next(epoch, value)) {
+                if (!loadNextPart()) {
+                    finished = true;
+                }
+                continue;
+            }
+            --remaining;
+            if (epoch < start) {
+                continue;
+            }
+            if (epoch > end) {
+                finished = true;
+                break;
+            }
+            sample = Sample{epoch, value};
+            return true;
+        }
+        return false;
+    }
+};
+
+BlockStore::BlockStore(const std::string& directory) : directory(directory) {}
+
+std::string BlockStore::segmentPath(int sensor, std::int64_t start) const {
+    return directory + "/" + std::to_string(sensor) + "-" + std::to_string(start) + ".blk";
+}
+
+// Reads the block headers of a segment. A block cut short by a crash is
+// dropped and the file truncated before it.
+bool BlockStore::loadSegment(Series& target, std::int64_t start, const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Can't open segment: " << path << std::endl;
+        return false;
+    }
+    std::uint64_t size = std::filesystem::file_size(path);
+
+    Segment segment{start, path, {}};
+    std::uint64_t offset = 0;
+    char header[HEADER_BYTES];
+    while (offset + HEADER_BYTES <= size) {
+        file.seekg(static_cast<std::streamoff>(offset));
+        if (!file.read(header, HEADER_BYTES)) {
+            break;
+        }
+        BlockInfo info;
+        decodeHeader(header, info);
+        info.offset = offset;
+        if (info.count == 0 || offset + HEADER_BYTES + info.payloadBytes > size) {
+            break;
+        }
+        segment.blocks.push_back(info);
+        offset += HEADER_BYTES + info.payloadBytes;
+    }
+    file.close();
+
+    if (offset < size) {
+        std::cerr << "Truncating damaged segment " << path << " at " << offset << std::endl;
+        std::error_code error;
+        std::filesystem::resize_file(path, offset, error);
+    }
+    target.segments.push_back(std::move(segment));
+    return true;
+}
+
+bool BlockStore::open() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Can't create block directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        int sensor;
+        long long start;
+        char extension[8];
+        std::string name = entry.path().filename().string();
+        if (std::sscanf(name.c_str(), "%d-%lld.%7s", &sensor, &start, extension) != 3 || std::strcmp(extension, "blk") != 0) {
+            continue;
+        }
+        loadSegment(series[sensor], start, entry.path().string());
+    }
+
+    // The newest block of every sensor is re-encoded so appends can continue it.
+    for (auto& entry : series) {
+        Series& target = entry.second;
+        std::sort(target.segments.begin(), target.segments.end(),
+                  [](const Segment& a, const Segment& b) { return a.start < b.start; });
+        if (target.segments.empty() || target.segments.back().blocks.empty()) {
+            continue;
+        }
+        const BlockInfo& last = target.segments.back().blocks.back();
+        if (last.count >= BLOCK_SAMPLES) {
+            continue;
+        }
+        std::ifstream file(target.segments.back().path, std::ios::binary);
+        std::string payload;
+        if (!readPayload(file, last, payload)) {
+            continue;
+        }
+        GorillaDecoder decoder(payload.data(), payload.size());
+        std::int64_t epoch;
+        float value;
+        for (std::uint32_t i = 0; i < last.count && decoder.next(epoch, value); ++i) {
+            target.open.append(epoch, value);
+        }
+    }
+    return true;
+}
+
+void BlockStore::writeOpenBlock(Series& target) {
+    Segment& segment = target.segments.back();
+    if (target.writerPath != segment.path) {
+        target.writer.reset();
+        std::ofstream(segment.path, std::ios::binary | std::ios::app).close();
+        target.writer = std::make_unique<std::fstream>(segment.path, std::ios::binary | std::ios::in | std::ios::out);
+        target.writerPath = segment.path;
+    }
+
+    const BlockInfo& info = segment.blocks.back();
+    char header[HEADER_BYTES];
+    encodeHeader(info, header);
+    target.writer->seekp(static_cast<std::streamoff>(info.offset));
+    target.writer->write(header, HEADER_BYTES);
+    target.writer->write(target.open.data().data(), static_cast<std::streamsize>(target.open.data().size()));
+    target.writer->flush();
+    if (!*target.writer) {
+        std::cerr << "Failed to write block to " << segment.path << std::endl;
+        target.writer.reset();
+        target.writerPath.clear();
+    }
+    target.dirty = false;
+}
+
+bool BlockStore::append(int sensor, const Sample& sample) {
+    std::int64_t epoch = sample.epoch;
+    float value = static_cast<float>(sample.temperature);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    Series& target = series[sensor];
+    if (!target.segments.empty() && !target.segments.back().blocks.empty() &&
+        epoch <= target.segments.back().blocks.back().lastEpoch) {
+        return false;
+    }
+
+    std::int64_t start = segmentStart(epoch);
+    if (target.segments.empty() || target.segments.back().start != start) {
+        if (target.dirty) {
+            writeOpenBlock(target);
+        }
+        target.open = GorillaEncoder();
+        target.segments.push_back(Segment{start, segmentPath(sensor, start), {}});
+    } else if (target.open.size() >= BLOCK_SAMPLES) {
+        if (target.dirty) {
+            writeOpenBlock(target);
+        }
+        target.open = GorillaEncoder();
+    }
+
+    std::vector<BlockInfo>& blocks = target.segments.back().blocks;
+    if (target.open.size() == 0) {
+        std::uint64_t offset = blocks.empty() ? 0 : blocks.back().offset + HEADER_BYTES + blocks.back().payloadBytes;
+        blocks.push_back(BlockInfo{epoch, epoch, 0, value, value, 0.0, offset, 0});
+    }
+
+    BlockInfo& info = blocks.back();
+    target.open.append(epoch, value);
+    info.lastEpoch = epoch;
+    info.count = target.open.size();
+    info.min = std::min(info.min, value);
+    info.max = std::max(info.max, value);
+    info.sum += value;
+    info.payloadBytes = static_cast<std::uint32_t>(target.open.data().size());
+    target.dirty = true;
+    return true;
+}
+
+void BlockStore::flush() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    for (auto& entry : series) {
+        if (entry.second.dirty) {
+            writeOpenBlock(entry.second);
+        }
+    }
+}
+
+std::unique_ptr<SampleCursor> BlockStore::scan(int sensor, std::int64_t start, std::int64_t end) const {
+    return std::make_unique<BlockCursor>(*this, sensor, start, end);
+}
+
+// Blocks that lie entirely inside the range are summed from their headers;
+// only the blocks at the edges are decoded.
+Bucket BlockStore::summarize(int sensor, std::int64_t start, std::int64_t end) const {
+    Bucket bucket{start, 0.0, 0.0, 0.0, 0};
+    auto addValue = [&bucket](double sum, double min, double max, std::int64_t count) {
+        if (bucket.count == 0) {
+            bucket.min = min;
+            bucket.max = max;
+        }
+        bucket.sum += sum;
+        bucket.min = std::min(bucket.min, min);
+        bucket.max = std::max(bucket.max, max);
+        bucket.count += count;
+    };
+
+    std::vector<std::pair<std::int64_t, std::int64_t>> edges;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = series.find(sensor);
+        if (it == series.end()) {
+            return bucket;
+        }
+        for (const Segment& segment : it->second.segments) {
+            for (const BlockInfo& info : segment.blocks) {
+                if (info.lastEpoch < start || info.firstEpoch >= end) {
+                    continue;
+                }
+                if (info.firstEpoch >= start && info.lastEpoch < end) {
+                    addValue(info.sum, info.min, info.max, info.count);
+                } else {
+                    edges.emplace_back(std::max(start, info.firstEpoch), std::min(end - 1, info.lastEpoch));
+                }
+            }
+        }
+    }
+
+    for (const auto& edge : edges) {
+        std::unique_ptr<SampleCursor> cursor = scan(sensor, edge.first, edge.second);
+        Sample sample;
+        while (cursor->next(sample)) {
+            addValue(sample.temperature, sample.temperature, sample.temperature, 1);
+        }
+    }
+    return bucket;
+}
+
+bool BlockStore::firstSample(int sensor, Sample& sample) const {
+    std::int64_t first;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = series.find(sensor);
+        if (it == series.end() || it->second.segments.empty() || it->second.segments.front().blocks.empty()) {
+            return false;
+        }
+        first = it->second.segments.front().blocks.front().firstEpoch;
+    }
+    return scan(sensor, first, first)->next(sample);
+}
+
+bool BlockStore::lastSample(int sensor, Sample& sample) const {
+    std::int64_t last;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = series.find(sensor);
+        if (it == series.end() || it->second.segments.empty() || it->second.segments.back().blocks.empty()) {
+            return false;
+        }
+        last = it->second.segments.back().blocks.back().lastEpoch;
+    }
+    return scan(sensor, last, last)->next(sample);
+}
+
+std::int64_t BlockStore::dropBoundary(std::int64_t cutoff) const {
+    return segmentStart(cutoff);
+}
+
+size_t BlockStore::dropBefore(std::int64_t cutoff) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t dropped = 0;
+    for (auto& entry : series) {
+        Series& target = entry.second;
+        while (!target.segments.empty() && target.segments.front().start + SEGMENT_SECONDS <= cutoff) {
+            if (target.segments.size() == 1) {
+                target.writer.reset();
+                target.writerPath.clear();
+                target.open = GorillaEncoder();
+                target.dirty = false;
+            }
+            std::remove(target.segments.front().path.c_str());
+            target.segments.erase(target.segments.begin());
+            ++dropped;
+        }
+    }
+    return dropped;
+}
+
+std::uint64_t BlockStore::diskBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::uint64_t total = 0;
+    for (const auto& entry : series) {
+        for (const Segment& segment : entry.second.segments) {
+            std::error_code error;
+            std::uint64_t size = std::filesystem::file_size(segment.path, error);
+            total += error ? 0 : size;
+        }
+    }
+    return total;
+}
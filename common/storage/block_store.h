@@ -0,0 +1,86 @@
+#ifndef BLOCK_STORE_H
+#define BLOCK_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <shared_mutex>
+#include "gorilla_codec.h"
+#include "storage_backend.h"
+
+// Index entry of one block, also stored on disk as the block's header.
+struct BlockInfo {
+    std::int64_t firstEpoch;
+    std::int64_t lastEpoch;
+    std::uint32_t count;
+    float min;
+    float max;
+    double sum;
+    std::uint64_t offset;
+    std::uint32_t payloadBytes;
+};
+
+// Append-only, compressed storage for one measurement table. Every sensor's
+// samples go to one segment file per UTC day, <directory>/<sensor>-<day
+// start epoch>.blk. A segment is a sequence of blocks, each a fixed header
+// (time range, count, min, max, sum, payload size) followed by up to
+// BLOCK_SAMPLES samples in Gorilla encoding. The headers are read into memory
+// on open and serve as the index: a range read touches only the blocks that
+// overlap it, and a summary decodes only the blocks at its edges.
+//
+// Samples must arrive in epoch order per sensor; a sample that is not newer
+// than the sensor's last one is rejected. Values are stored as float. The
+// newest block of a sensor stays open in memory and is rewritten in place by
+// flush(), so a crash loses nothing that was flushed. Retention deletes
+// whole segment files.
+class BlockStore : public StorageBackend {
+private:
+    struct Segment {
+        std::int64_t start;
+        std::string path;
+        std::vector<BlockInfo> blocks;
+    };
+
+    struct Series {
+        std::vector<Segment> segments;
+        GorillaEncoder open;
+        bool dirty = false;
+        std::unique_ptr<std::fstream> writer;
+        std::string writerPath;
+    };
+
+    std::string directory;
+    std::map<int, Series> series;
+    mutable std::shared_mutex mutex;
+
+    std::string segmentPath(int sensor, std::int64_t start) const;
+    bool loadSegment(Series& target, std::int64_t start, const std::string& path);
+    void writeOpenBlock(Series& target);
+
+    friend class BlockCursor;
+
+public:
+    explicit BlockStore(const std::string& directory);
+
+    // Creates the directory if needed and reads the index of every segment.
+    bool open() override;
+
+    bool append(int sensor, const Sample& sample) override;
+    // Writes every open block that changed since the last flush.
+    void flush() override;
+
+    std::unique_ptr<SampleCursor> scan(int sensor, std::int64_t start, std::int64_t end) const override;
+    Bucket summarize(int sensor, std::int64_t start, std::int64_t end) const override;
+    bool firstSample(int sensor, Sample& sample) const override;
+    bool lastSample(int sensor, Sample& sample) const override;
+    // Deletes the segments of every sensor that end at or before cutoff.
+    size_t dropBefore(std::int64_t cutoff) override;
+    std::int64_t dropBoundary(std::int64_t cutoff) const override;
+
+    std::uint64_t diskBytes() const;
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "gorilla_codec.h"
+#include <cmath>
+#include <cstring>
+
+#define DECIMAL_SCALE 100
+// Keeps value * DECIMAL_SCALE below 2^24, where floats hold whole numbers exactly.
+#define DECIMAL_LIMIT 100000.0f
+
+static std::uint32_t floatBits(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(std::uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int leadingZeros(std::uint32_t value) {
+    int zeros = 0;
+    while (!(value & 0x80000000u)) {
+        value <<= 1;
+        ++zeros;
+    }
+    return zeros;
+}
+
+static int trailingZeros(std::uint32_t value) {
+    int zeros = 0;
+    while (!(value & 1u)) {
+        value >>= 1;
+        ++zeros;
+    }
+    return zeros;
+}
+
+// Sets scaled to the value in hundredths if the float is exactly what
+// scaled / DECIMAL_SCALE rounds to, so the decoder gets the same bits back.
+static bool decimalValue(std::uint32_t bits, std::int64_t& scaled) {
+    float value = bitsFloat(bits);
+    if (!(std::fabs(value) < DECIMAL_LIMIT)) {
+        return false;
+    }
+    scaled = std::llround(static_cast<double>(value) * DECIMAL_SCALE);
+    return floatBits(static_cast<float>(scaled) / DECIMAL_SCALE) == bits;
+}
+
+GorillaEncoder::GorillaEncoder() :
+    freeBits(0), count(0), previousEpoch(0), previousDelta(0), previousBits(0), leading(-1), trailing(0) {}
+
+void GorillaEncoder::writeBits(std::uint64_t value, int bits) {
+    while (bits > 0) {
+        if (freeBits == 0) {
+            bytes.push_back('\0');
+            freeBits = 8;
+        }
+        int chunk = bits < freeBits ? bits : freeBits;
+        std::uint64_t part = (value >> (bits - chunk)) & ((1u << chunk) - 1);
+        bytes.back() = static_cast<char>(static_cast<unsigned char>(bytes.back()) | (part << (freeBits - chunk)));
+        freeBits -= chunk;
+        bits -= chunk;
+    }
+}
+
+void GorillaEncoder::writeValue(std::uint32_t bits) {
+    if (bits == previousBits) {
+        writeBits(0, 1);
+        return;
+    }
+
+    std::int64_t scaled, previousScaled;
+    if (decimalValue(bits, scaled) && decimalValue(previousBits, previousScaled)) {
+        std::int64_t change = scaled - previousScaled;
+        if (change >= -8 && change <= 7) {
+            writeBits(0x4, 3);
+            writeBits(static_cast<std::uint64_t>(change + 8), 4);
+            return;
+        } else if (change >= -128 && change <= 127) {
+            writeBits(0xA, 4);
+            writeBits(static_cast<std::uint64_t>(change + 128), 8);
+            return;
+        } else if (change >= -524288 && change <= 524287) {
+            writeBits(0xB, 4);
+            writeBits(static_cast<std::uint64_t>(change + 524288), 20);
+            return;
+        }
+    }
+
+    std::uint32_t difference = bits ^ previousBits;
+    int zerosBefore = leadingZeros(difference);
+    int zerosAfter = trailingZeros(difference);
+    if (leading >= 0 && zerosBefore >= leading && zerosAfter >= trailing) {
+        writeBits(0x6, 3);
+        writeBits(difference >> trailing, 32 - leading - trailing);
+    } else {
+        int meaningful = 32 - zerosBefore - zerosAfter;
+        writeBits(0x7, 3);
+        writeBits(static_cast<std::uint64_t>(zerosBefore), 5);
+        writeBits(static_cast<std::uint64_t>(meaningful - 1), 5);
+        writeBits(difference >> zerosAfter, meaningful);
+        leading = zerosBefore;
+        trailing = zerosAfter;
+    }
+}
+
+void GorillaEncoder::append(std::int64_t epoch, float value) {
+    std::uint32_t bits = floatBits(value);
+    if (count == 0) {
+        writeBits(static_cast<std::uint64_t>(epoch), 64);
+        writeBits(bits, 32);
+    } else {
+        std::int64_t delta = epoch - previousEpoch;
+        std::int64_t deltaOfDelta = delta - previousDelta;
+        if (deltaOfDelta == 0) {
+            writeBits(0, 1);
+        } else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+            writeBits(0x2, 2);
+            writeBits(static_cast<std::uint64_t>(deltaOfDelta + 63), 7);
+        } else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+            writeBits(0x6, 3);
+            writeBits(static_cast<std::uint64_t>(deltaOfDelta + 255), 9);
+        } else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+            writeBits(0xE, 4);
+            writeBits(static_cast<std::uint64_t>(deltaOfDelta + 2047), 12);
+        } else {
+            writeBits(0xF, 4);
+            writeBits(static_cast<std::uint64_t>(deltaOfDelta), 64);
+        }
+        previousDelta = delta;
+
+        writeValue(bits);
+    }
+    previousEpoch = epoch;
+    previousBits = bits;
+    ++count;
+}
+
+GorillaDecoder::GorillaDecoder(const char* data, size_t length) :
+    data(reinterpret_cast<const unsigned char*>(data)), length(length), bitPosition(0), decoded(0),
+    previousEpoch(0), previousDelta(0), previousBits(0), leading(0), trailing(0) {}
+
+bool GorillaDecoder::readBits(int bits, std::uint64_t& value) {
+    if (bitPosition + bits > length * 8) {
+        return false;
+    }
+    value = 0;
+    while (bits > 0) {
+        size_t byte = bitPosition / 8;
+        int offset = static_cast<int>(bitPosition % 8);
+        int available = 8 - offset;
+        int chunk = bits < available ? bits : available;
+        std::uint64_t part = (data[byte] >> (available - chunk)) & ((1u << chunk) - 1);
+        value = (value << chunk) | part;
+        bitPosition += chunk;
+        bits -= chunk;
+    }
+    return true;
+}
+
+bool GorillaDecoder::readValue() {
+    std::uint64_t bits;
+    if (!readBits(1, bits)) {
+        return false;
+    }
+    if (bits == 0) {
+        return true;
+    }
+    if (!readBits(1, bits)) {
+        return false;
+    }
+
+    if (bits == 0) {
+        std::int64_t previousScaled;
+        if (!readBits(1, bits) || !decimalValue(previousBits, previousScaled)) {
+            return false;
+        }
+        int width = 4;
+        if (bits == 1) {
+            if (!readBits(1, bits)) {
+                return false;
+            }
+            width = bits == 0 ? 8 : 20;
+        }
+        std::uint64_t change;
+        if (!readBits(width, change)) {
+            return false;
+        }
+        std::int64_t scaled = previousScaled + static_cast<std::int64_t>(change) - (std::int64_t(1) << (width - 1));
+        previousBits = floatBits(static_cast<float>(scaled) / DECIMAL_SCALE);
+        return true;
+    }
+
+    if (!readBits(1, bits)) {
+        return false;
+    }
+    if (bits == 1) {
+        std::uint64_t zerosBefore, meaningful;
+        if (!readBits(5, zerosBefore) || !readBits(5, meaningful)) {
+            return false;
+        }
+        leading = static_cast<int>(zerosBefore);
+        trailing = 32 - leading - static_cast<int>(meaningful + 1);
+        if (trailing < 0) {
+            return false;
+        }
+    }
+    if (!readBits(32 - leading - trailing, bits)) {
+        return false;
+    }
+    previousBits ^= static_cast<std::uint32_t>(bits << trailing);
+    return true;
+}
+
+bool GorillaDecoder::next(std::int64_t& epoch, float& value) {
+    std::uint64_t bits = 0;
+    if (decoded == 0) {
+        if (!readBits(64, bits)) {
+            return false;
+        }
+        previousEpoch = static_cast<std::int64_t>(bits);
+        if (!readBits(32, bits)) {
+            return false;
+        }
+        previousBits = static_cast<std::uint32_t>(bits);
+    } else {
+        int prefix = 0;
+        while (prefix < 4) {
+            if (!readBits(1, bits)) {
+                return false;
+            }
+            if (bits == 0) {
+                break;
+            }
+            ++prefix;
+        }
+
+        std::int64_t deltaOfDelta = 0;
+        static const int WIDTHS[] = {0, 7, 9, 12, 64};
+        static const std::int64_t BIASES[] = {0, 63, 255, 2047, 0};
+        if (prefix > 0) {
+            if (!readBits(WIDTHS[prefix], bits)) {
+                return false;
+            }
+            deltaOfDelta = static_cast<std::int64_t>(bits) - BIASES[prefix];
+        }
+        previousDelta += deltaOfDelta;
+        previousEpoch += previousDelta;
+
+        if (!readValue()) {
+            return false;
+        }
+    }
+
+    ++decoded;
+    epoch = previousEpoch;
+    value = bitsFloat(previousBits);
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef GORILLA_CODEC_H
+#define GORILLA_CODEC_H
+
+#include <cstdint>
+#include <string>
+
+// Bit-level compression of one time-ordered series, after Facebook's Gorilla
+// paper. The first sample is stored verbatim; after that every timestamp is
+// stored as the change of its delta from the previous one (delta-of-delta)
+// and every value either as its change in hundredths or as the XOR of its
+// float bits with the previous value:
+//
+//   timestamp  '0'                      delta unchanged
+//              '10'   + 7 bits          delta-of-delta in [-63, 64]
+//              '110'  + 9 bits          in [-255, 256]
+//              '1110' + 12 bits         in [-2047, 2048]
+//              '1111' + 64 bits         anything else
+//   value      '0'                      same value
+//              '100'  + 4 bits          change in hundredths in [-8, 7]
+//              '1010' + 8 bits          in [-128, 127]
+//              '1011' + 20 bits         in [-524288, 524287]
+//              '110'  + meaningful bits XOR fits the previous leading/trailing window
+//              '111'  + 5 bits leading zeros + 5 bits (length - 1) + meaningful bits
+//
+// The sensors send two decimals, whose float bits differ in most of the
+// mantissa from one reading to the next, so the change in hundredths is used
+// whenever both values are exactly a whole number of hundredths. A steady
+// 1 Hz stream of repeated readings costs 2 bits per sample, a slowly drifting
+// one about 9.
+class GorillaEncoder {
+private:
+    std::string bytes;
+    std::uint8_t freeBits;
+    std::uint32_t count;
+    std::int64_t previousEpoch;
+    std::int64_t previousDelta;
+    std::uint32_t previousBits;
+    int leading;
+    int trailing;
+
+    void writeValue(std::uint32_t bits);
+    void writeBits(std::uint64_t value, int bits);
+
+public:
+    GorillaEncoder();
+
+    void append(std::int64_t epoch, float value);
+    std::uint32_t size() const { return count; }
+    const std::string& data() const { return bytes; }
+};
+
+// Reads back what a GorillaEncoder wrote; the caller knows how many samples
+// the data holds.
+class GorillaDecoder {
+private:
+    const unsigned char* data;
+    size_t length;
+    size_t bitPosition;
+    std::uint32_t decoded;
+    std::int64_t previousEpoch;
+    std::int64_t previousDelta;
+    std::uint32_t previousBits;
+    int leading;
+    int trailing;
+
+    bool readValue();
+    bool readBits(int bits, std::uint64_t& value);
+
+public:
+    GorillaDecoder(const char* data, size_t length);
+
+    // False once the data is exhausted or malformed.
+    bool next(std::int64_t& epoch, float& value);
+};
+
+#endif
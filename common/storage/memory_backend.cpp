@@ -0,0 +1,83 @@
+#include "memory_backend.h"
+#include <algorithm>
+#include <mutex>
+
+static std::vector<Sample>::const_iterator lowerBound(const std::vector<Sample>& samples, std::int64_t epoch) {
+    return std::lower_bound(samples.begin(), samples.end(), epoch,
+                            [](const Sample& sample, std::int64_t value) { return sample.epoch < value; });
+}
+
+bool MemoryBackend::append(int sensor, const Sample& sample) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::vector<Sample>& samples = series[sensor];
+    if (!samples.empty() && sample.epoch <= samples.back().epoch) {
+        return false;
+    }
+    samples.push_back(sample);
+    return true;
+}
+
+// The range is copied out under the lock, as the hot tier does.
+std::unique_ptr<SampleCursor> MemoryBackend::scan(int sensor, std::int64_t start, std::int64_t end) const {
+    std::vector<Sample> output;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it != series.end()) {
+        for (auto sample = lowerBound(it->second, start); sample != it->second.end() && sample->epoch <= end; ++sample) {
+            output.push_back(*sample);
+        }
+    }
+    return std::make_unique<VectorCursor>(std::move(output));
+}
+
+Bucket MemoryBackend::summarize(int sensor, std::int64_t start, std::int64_t end) const {
+    Bucket bucket{start, 0.0, 0.0, 0.0, 0};
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it == series.end()) {
+        return bucket;
+    }
+    for (auto sample = lowerBound(it->second, start); sample != it->second.end() && sample->epoch < end; ++sample) {
+        if (bucket.count == 0) {
+            bucket.min = sample->temperature;
+            bucket.max = sample->temperature;
+        }
+        bucket.sum += sample->temperature;
+        bucket.min = std::min(bucket.min, sample->temperature);
+        bucket.max = std::max(bucket.max, sample->temperature);
+        ++bucket.count;
+    }
+    return bucket;
+}
+
+bool MemoryBackend::firstSample(int sensor, Sample& sample) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it == series.end() || it->second.empty()) {
+        return false;
+    }
+    sample = it->second.front();
+    return true;
+}
+
+bool MemoryBackend::lastSample(int sensor, Sample& sample) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it == series.end() || it->second.empty()) {
+        return false;
+    }
+    sample = it->second.back();
+    return true;
+}
+
+size_t MemoryBackend::dropBefore(std::int64_t cutoff) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t dropped = 0;
+    for (auto& entry : series) {
+        std::vector<Sample>& samples = entry.second;
+        auto keep = lowerBound(samples, cutoff);
+        dropped += static_cast<size_t>(keep - samples.cbegin());
+        samples.erase(samples.cbegin(), keep);
+    }
+    return dropped;
+}
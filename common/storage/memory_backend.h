@@ -0,0 +1,28 @@
+#ifndef MEMORY_BACKEND_H
+#define MEMORY_BACKEND_H
+
+#include <map>
+#include <shared_mutex>
+#include "storage_backend.h"
+
+// Every sample in a sorted vector per sensor, lost when the process exits.
+// Meant as the baseline the persistent engines are measured against.
+class MemoryBackend : public StorageBackend {
+private:
+    std::map<int, std::vector<Sample>> series;
+    mutable std::shared_mutex mutex;
+
+public:
+    bool open() override { return true; }
+
+    bool append(int sensor, const Sample& sample) override;
+
+    std::unique_ptr<SampleCursor> scan(int sensor, std::int64_t start, std::int64_t end) const override;
+    Bucket summarize(int sensor, std::int64_t start, std::int64_t end) const override;
+    bool firstSample(int sensor, Sample& sample) const override;
+    bool lastSample(int sensor, Sample& sample) const override;
+
+    size_t dropBefore(std::int64_t cutoff) override;
+};
+
+#endif
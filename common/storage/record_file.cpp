@@ -0,0 +1,163 @@
+#include "record_file.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#define RECORD_SIZE 12
+#define MIN_MAPPING_BYTES (64 * 1024)
+
+RecordFile::RecordFile(const std::string& path) :
+    path(path), data(nullptr), mappedBytes(0), fileBytes(0),
+#if defined(_WIN32)
+    file(INVALID_HANDLE_VALUE), mapping(NULL) {
+#else
+    fd(-1) {
+#endif
+    // A record cut short by a crash would shift every later one.
+    std::error_code error;
+    std::uintmax_t bytes = std::filesystem::file_size(path, error);
+    if (!error && bytes % RECORD_SIZE != 0) {
+        std::cerr << "Dropping incomplete record at the end of " << path << std::endl;
+        std::filesystem::resize_file(path, bytes - bytes % RECORD_SIZE, error);
+    }
+
+#if defined(_WIN32)
+    file = CreateFileA(path.c_str(), GENERIC_READ | FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return;
+    }
+    fileBytes = static_cast<size_t>(size.QuadPart);
+#else
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return;
+    }
+    fileBytes = static_cast<size_t>(status.st_size);
+#endif
+    fileBytes -= fileBytes % RECORD_SIZE;
+    remap();
+}
+
+RecordFile::~RecordFile() {
+    unmap();
+#if defined(_WIN32)
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+    if (fd >= 0) close(fd);
+#endif
+}
+
+void RecordFile::unmap() {
+#if defined(_WIN32)
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    mapping = NULL;
+#else
+    if (data) munmap(const_cast<char*>(data), mappedBytes);
+#endif
+    data = nullptr;
+    mappedBytes = 0;
+}
+
+bool RecordFile::remap() {
+    unmap();
+    if (fileBytes == 0) {
+        return true;
+    }
+
+#if defined(_WIN32)
+    size_t bytes = fileBytes;
+    mapping = file != INVALID_HANDLE_VALUE ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(bytes)) : NULL;
+    if (!view) {
+        std::cerr << "Error mapping file: " << path << std::endl;
+        unmap();
+        return false;
+    }
+#else
+    size_t bytes = std::max<size_t>(2 * fileBytes, MIN_MAPPING_BYTES);
+    void* view = fd >= 0 ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (view == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << path << std::endl;
+        return false;
+    }
+#endif
+    data = static_cast<const char*>(view);
+    mappedBytes = bytes;
+    return true;
+}
+
+bool RecordFile::append(const Record& record) {
+    char buffer[RECORD_SIZE];
+    std::memcpy(buffer, &record.epoch, 8);
+    std::memcpy(buffer + 8, &record.temperature, 4);
+
+#if defined(_WIN32)
+    DWORD written = 0;
+    bool complete = file != INVALID_HANDLE_VALUE && WriteFile(file, buffer, RECORD_SIZE, &written, NULL) &&
+                    written == RECORD_SIZE;
+#else
+    ssize_t written = fd >= 0 ? write(fd, buffer, RECORD_SIZE) : -1;
+    bool complete = written == RECORD_SIZE;
+#endif
+    if (!complete) {
+        std::cerr << "Error writing file: " << path << std::endl;
+        return false;
+    }
+    fileBytes += RECORD_SIZE;
+    if (fileBytes > mappedBytes) {
+        remap();
+    }
+    return true;
+}
+
+size_t RecordFile::size() const {
+    return std::min(fileBytes, mappedBytes) / RECORD_SIZE;
+}
+
+Record RecordFile::at(size_t index) const {
+    Record record;
+    const char* slot = data + index * RECORD_SIZE;
+    std::memcpy(&record.epoch, slot, 8);
+    std::memcpy(&record.temperature, slot + 8, 4);
+    return record;
+}
+
+size_t RecordFile::lowerBound(std::int64_t epoch) const {
+    size_t low = 0, high = size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (at(middle).epoch < epoch) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+size_t RecordFile::upperBound(std::int64_t epoch) const {
+    size_t low = 0, high = size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (at(middle).epoch <= epoch) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,60 @@
+#ifndef RECORD_FILE_H
+#define RECORD_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#endif
+
+struct Record {
+    std::int64_t epoch;
+    float temperature;
+};
+
+// A data file of fixed 12-byte records (int64 epoch, float temperature, in
+// the machine's byte order) kept in epoch order. Records are appended with
+// write() on a descriptor that stays open and read through a read-only
+// memory mapping, so a lookup is a binary search over memory and a range is
+// a contiguous slice of it. The mapping reaches twice as far as the file, and
+// appends land in it through the page cache until the file outgrows it;
+// Windows cannot map past the end of a read-only file, so there it follows
+// the file size. Only append() changes the mapping, so the readers can share
+// the file as long as the owner keeps them apart from appends.
+class RecordFile {
+private:
+    std::string path;
+    const char* data;
+    size_t mappedBytes;
+    size_t fileBytes;
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+
+    void unmap();
+    bool remap();
+
+public:
+    explicit RecordFile(const std::string& path);
+    ~RecordFile();
+    RecordFile(const RecordFile&) = delete;
+    RecordFile& operator=(const RecordFile&) = delete;
+
+    const std::string& getPath() const { return path; }
+
+    bool append(const Record& record);
+
+    size_t size() const;
+    // Valid for index < size().
+    Record at(size_t index) const;
+    // Index of the first record with epoch >= epoch, or > epoch for upperBound.
+    size_t lowerBound(std::int64_t epoch) const;
+    size_t upperBound(std::int64_t epoch) const;
+};
+
+#endif
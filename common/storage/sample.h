@@ -0,0 +1,20 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <cstdint>
+
+struct Sample {
+    std::int64_t epoch;
+    double temperature;
+};
+
+// Summary of the samples whose epoch falls in [epoch, epoch + bucket width).
+struct Bucket {
+    std::int64_t epoch;
+    double sum;
+    double min;
+    double max;
+    std::int64_t count;
+};
+
+#endif
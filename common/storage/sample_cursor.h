@@ -0,0 +1,33 @@
+#ifndef SAMPLE_CURSOR_H
+#define SAMPLE_CURSOR_H
+
+#include <vector>
+#include "sample.h"
+
+// Yields the samples of a range one at a time, in epoch order.
+class SampleCursor {
+public:
+    virtual ~SampleCursor() = default;
+    // False once the range is exhausted.
+    virtual bool next(Sample& sample) = 0;
+};
+
+// Samples that were already copied into memory.
+class VectorCursor : public SampleCursor {
+private:
+    std::vector<Sample> samples;
+    size_t position;
+
+public:
+    explicit VectorCursor(std::vector<Sample> samples) : samples(std::move(samples)), position(0) {}
+
+    bool next(Sample& sample) override {
+        if (position == samples.size()) {
+            return false;
+        }
+        sample = samples[position++];
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "segment_manifest.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+
+SegmentManifest::SegmentManifest(const std::string& directory, const std::string& extension, std::int64_t span) :
+    directory(directory), extension(extension), span(span) {}
+
+std::string SegmentManifest::manifestPath() const {
+    return (std::filesystem::path(directory) / "manifest").string();
+}
+
+bool SegmentManifest::load() {
+    segments.clear();
+    std::error_code error;
+    if (!std::filesystem::is_directory(directory, error)) {
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "Can't create " << directory << ": " << error.message() << std::endl;
+        }
+        return false;
+    }
+
+    std::ifstream manifest(manifestPath());
+    if (!manifest.is_open()) {
+        std::cerr << "No manifest in " << directory << ", rebuilding it from the segment files" << std::endl;
+        scanDirectory();
+        save();
+        return true;
+    }
+
+    long long start, end;
+    std::string name;
+    while (manifest >> start >> end >> name) {
+        std::string path = (std::filesystem::path(directory) / name).string();
+        if (!std::filesystem::exists(path, error)) {
+            std::cerr << "Missing segment " << path << ", skipping it" << std::endl;
+            continue;
+        }
+        segments.push_back(Segment{start, end, path});
+    }
+    return true;
+}
+
+void SegmentManifest::scanDirectory() {
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::filesystem::path path = entry.path();
+        std::string stem = path.stem().string();
+        if (path.extension() != extension || stem.empty() ||
+            stem.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        std::int64_t start = std::stoll(stem);
+        segments.push_back(Segment{start, start + span, path.string()});
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const Segment& a, const Segment& b) { return a.start < b.start; });
+}
+
+// Written to a temporary file and renamed so a crash never leaves half a list.
+bool SegmentManifest::save() const {
+    std::string temporary = manifestPath() + ".tmp";
+    {
+        std::ofstream manifest(temporary, std::ios_base::trunc);
+        if (!manifest.is_open()) {
+            std::cerr << "Error opening file for writing: " << temporary << std::endl;
+            return false;
+        }
+        for (const Segment& segment : segments) {
+            manifest << segment.start << ' ' << segment.end << ' '
+                     << std::filesystem::path(segment.path).filename().string() << '\n';
+        }
+        if (!manifest) {
+            std::cerr << "Error writing file: " << temporary << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, manifestPath(), error);
+    if (error) {
+        std::cerr << "Can't replace " << manifestPath() << ": " << error.message() << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+Segment SegmentManifest::segmentFor(std::int64_t epoch) {
+    auto it = std::upper_bound(segments.begin(), segments.end(), epoch,
+                               [](std::int64_t value, const Segment& segment) { return value < segment.start; });
+    if (it != segments.begin() && epoch < std::prev(it)->end) {
+        return *std::prev(it);
+    }
+
+    std::int64_t start = epoch - ((epoch % span) + span) % span;
+    std::string name = std::to_string(start) + extension;
+    Segment segment{start, start + span, (std::filesystem::path(directory) / name).string()};
+    segments.insert(it, segment);
+    save();
+    return segment;
+}
+
+std::vector<Segment> SegmentManifest::overlapping(std::int64_t start, std::int64_t end) const {
+    std::vector<Segment> result;
+    for (const Segment& segment : segments) {
+        if (segment.start <= end && segment.end > start) {
+            result.push_back(segment);
+        }
+    }
+    return result;
+}
+
+std::vector<Segment> SegmentManifest::dropBefore(std::int64_t cutoff) {
+    auto firstKept = std::find_if(segments.begin(), segments.end(),
+                                  [cutoff](const Segment& segment) { return segment.end > cutoff; });
+    std::vector<Segment> dropped(segments.begin(), firstKept);
+    if (!dropped.empty()) {
+        segments.erase(segments.begin(), firstKept);
+        save();
+    }
+    return dropped;
+}
@@ -0,0 +1,51 @@
+#ifndef SEGMENT_MANIFEST_H
+#define SEGMENT_MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// One data file holding the samples with start <= epoch < end.
+struct Segment {
+    std::int64_t start;
+    std::int64_t end;
+    std::string path;
+};
+
+// A directory of data segments, each covering span seconds aligned to a
+// multiple of span, listed oldest first in "<directory>/manifest" as
+// "start end name" lines. Retention drops whole segments from the list and
+// the caller unlinks their files, so old samples are never rewritten.
+//
+// If the manifest is missing it is rebuilt from the "<start><extension>"
+// files in the directory.
+class SegmentManifest {
+private:
+    std::string directory;
+    std::string extension;
+    std::int64_t span;
+    std::vector<Segment> segments;
+
+    std::string manifestPath() const;
+    void scanDirectory();
+    bool save() const;
+
+public:
+    SegmentManifest(const std::string& directory, const std::string& extension, std::int64_t span);
+
+    // False if the directory did not exist yet; it is created empty.
+    bool load();
+
+    const std::string& getDirectory() const { return directory; }
+    const std::vector<Segment>& getSegments() const { return segments; }
+
+    // The segment epoch belongs in, added to the manifest if it is new.
+    Segment segmentFor(std::int64_t epoch);
+    // Segments with samples in [start, end].
+    std::vector<Segment> overlapping(std::int64_t start, std::int64_t end) const;
+    // Removes the segments that end at or before cutoff from the manifest
+    // and returns them; their files are left for the caller to unlink.
+    std::vector<Segment> dropBefore(std::int64_t cutoff);
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "segment_store.h"
+#include "timestamp.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+// Splits "YYYY-MM-DD HH:MM:SS [t]" into its epoch and temperature.
+static bool parseLine(const std::string& line, Sample& sample) {
+    if (line.length() < TIMESTAMP_LENGTH || !parseLocalTimestamp(line.c_str(), TIMESTAMP_LENGTH, sample.epoch)) {
+        return false;
+    }
+    size_t startPos = line.find('[', TIMESTAMP_LENGTH);
+    if (startPos == std::string::npos) {
+        return false;
+    }
+    char* end = nullptr;
+    sample.temperature = std::strtof(line.c_str() + startPos + 1, &end);
+    return end != line.c_str() + startPos + 1 && *end == ']';
+}
+
+SegmentStore::SegmentStore(const std::string& directory, StorageEngine engine, std::int64_t segmentSeconds) :
+    directory(directory), engine(engine), segmentSeconds(segmentSeconds) {}
+
+SegmentStore::Series& SegmentStore::seriesFor(int sensor) {
+    auto it = series.find(sensor);
+    if (it != series.end()) {
+        return it->second;
+    }
+    Series& target = series[sensor];
+    std::string extension = engine == StorageEngine::RECORDS ? ".bin" : ".txt";
+    target.manifest = std::make_unique<SegmentManifest>(directory + "/" + std::to_string(sensor), extension,
+                                                        segmentSeconds);
+    target.manifest->load();
+    loadEnds(target);
+    return target;
+}
+
+TextIndex& SegmentStore::indexFor(const Series& target, const Segment& segment) const {
+    std::lock_guard<std::mutex> lock(openMutex);
+    std::unique_ptr<TextIndex>& index = target.indexes[segment.start];
+    if (!index) {
+        index = std::make_unique<TextIndex>(segment.path);
+        index->load();
+    }
+    return *index;
+}
+
+RecordFile& SegmentStore::recordsFor(const Series& target, const Segment& segment) const {
+    std::lock_guard<std::mutex> lock(openMutex);
+    std::unique_ptr<RecordFile>& records = target.records[segment.start];
+    if (!records) {
+        records = std::make_unique<RecordFile>(segment.path);
+    }
+    return *records;
+}
+
+// Appends the samples of segment with start <= epoch <= end to output.
+void SegmentStore::readSegment(const Series& target, const Segment& segment, std::int64_t start, std::int64_t end,
+                               std::vector<Sample>& output) const {
+    if (engine == StorageEngine::RECORDS) {
+        const RecordFile& records = recordsFor(target, segment);
+        size_t last = records.upperBound(end);
+        for (size_t i = records.lowerBound(start); i < last; ++i) {
+            Record record = records.at(i);
+            output.push_back(Sample{record.epoch, record.temperature});
+        }
+        return;
+    }
+
+    std::uint64_t offset = indexFor(target, segment).seekOffset(start);
+    std::ifstream infile(segment.path, std::ios_base::binary);
+    infile.seekg(static_cast<std::streamoff>(offset));
+    std::string line;
+    Sample sample;
+    while (std::getline(infile, line)) {
+        if (!parseLine(line, sample)) {
+            continue;
+        }
+        if (sample.epoch > end) {
+            break;
+        }
+        if (sample.epoch >= start) {
+            output.push_back(sample);
+        }
+    }
+}
+
+bool SegmentStore::firstOf(const Series& target, const Segment& segment, Sample& sample) const {
+    if (engine == StorageEngine::RECORDS) {
+        const RecordFile& records = recordsFor(target, segment);
+        if (records.size() == 0) {
+            return false;
+        }
+        Record record = records.at(0);
+        sample = Sample{record.epoch, record.temperature};
+        return true;
+    }
+    std::ifstream infile(segment.path, std::ios_base::binary);
+    std::string line;
+    while (std::getline(infile, line)) {
+        if (parseLine(line, sample)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The first sample of the oldest segment that has one and the last of the
+// newest; a text segment is read from its last index entry on.
+void SegmentStore::loadEnds(Series& target) {
+    target.hasSamples = false;
+    const std::vector<Segment>& segments = target.manifest->getSegments();
+    for (const Segment& segment : segments) {
+        if (firstOf(target, segment, target.first)) {
+            target.hasSamples = true;
+            break;
+        }
+    }
+    std::vector<Sample> samples;
+    for (auto it = segments.rbegin(); target.hasSamples && it != segments.rend(); ++it) {
+        samples.clear();
+        std::int64_t from = it->start;
+        if (engine == StorageEngine::TEXT) {
+            TextIndex& index = indexFor(target, *it);
+            if (index.isEmpty()) continue;
+            from = index.getLastEpoch();
+        }
+        readSegment(target, *it, from, it->end - 1, samples);
+        if (!samples.empty()) {
+            target.last = samples.back();
+            break;
+        }
+    }
+}
+
+bool SegmentStore::open() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Can't create directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory(error) && !name.empty() && name.find_first_not_of("0123456789") == std::string::npos) {
+            seriesFor(std::stoi(name));
+        }
+    }
+    return true;
+}
+
+bool SegmentStore::append(int sensor, const Sample& sample) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    Series& target = seriesFor(sensor);
+    if (target.hasSamples && sample.epoch <= target.last.epoch) {
+        return false;
+    }
+
+    Segment segment = target.manifest->segmentFor(sample.epoch);
+    if (engine == StorageEngine::RECORDS) {
+        if (!recordsFor(target, segment).append(Record{sample.epoch, static_cast<float>(sample.temperature)})) {
+            return false;
+        }
+    } else {
+        // The index has to see the file as it was before anything is buffered for it.
+        TextIndex& index = indexFor(target, segment);
+        if (!target.writer.is_open() || target.writerSegment != segment.start) {
+            target.writer.close();
+            target.writer.clear();
+            target.writer.open(segment.path, std::ios_base::app | std::ios_base::binary);
+            target.writerSegment = segment.start;
+            if (!target.writer.is_open()) {
+                std::cerr << "Error opening file: " << segment.path << std::endl;
+                return false;
+            }
+        }
+
+        char timestamp[TIMESTAMP_BUFFER_SIZE];
+        formatLocalTimestamp(sample.epoch, timestamp, sizeof(timestamp));
+        char line[64];
+        int length = std::snprintf(line, sizeof(line), "%s [%g]\n", timestamp,
+                                   static_cast<double>(static_cast<float>(sample.temperature)));
+        target.writer.write(line, length);
+        if (!target.writer) {
+            std::cerr << "Error writing file: " << segment.path << std::endl;
+            return false;
+        }
+        index.onAppend(sample.epoch, static_cast<size_t>(length));
+    }
+
+    if (!target.hasSamples) {
+        target.first = sample;
+        target.hasSamples = true;
+    }
+    target.last = sample;
+    return true;
+}
+
+void SegmentStore::flush() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    for (auto& entry : series) {
+        if (entry.second.writer.is_open()) {
+            entry.second.writer.flush();
+        }
+    }
+}
+
+std::unique_ptr<SampleCursor> SegmentStore::scan(int sensor, std::int64_t start, std::int64_t end) const {
+    std::vector<Sample> output;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it != series.end()) {
+        for (const Segment& segment : it->second.manifest->overlapping(start, end)) {
+            readSegment(it->second, segment, start, end, output);
+        }
+    }
+    return std::make_unique<VectorCursor>(std::move(output));
+}
+
+Bucket SegmentStore::summarize(int sensor, std::int64_t start, std::int64_t end) const {
+    Bucket bucket{start, 0.0, 0.0, 0.0, 0};
+    std::unique_ptr<SampleCursor> cursor = scan(sensor, start, end - 1);
+    for (Sample sample; cursor->next(sample);) {
+        if (bucket.count == 0) {
+            bucket.min = sample.temperature;
+            bucket.max = sample.temperature;
+        }
+        bucket.sum += sample.temperature;
+        bucket.min = std::min(bucket.min, sample.temperature);
+        bucket.max = std::max(bucket.max, sample.temperature);
+        ++bucket.count;
+    }
+    return bucket;
+}
+
+bool SegmentStore::firstSample(int sensor, Sample& sample) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it == series.end() || !it->second.hasSamples) {
+        return false;
+    }
+    sample = it->second.first;
+    return true;
+}
+
+bool SegmentStore::lastSample(int sensor, Sample& sample) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = series.find(sensor);
+    if (it == series.end() || !it->second.hasSamples) {
+        return false;
+    }
+    sample = it->second.last;
+    return true;
+}
+
+size_t SegmentStore::dropBefore(std::int64_t cutoff) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t dropped = 0;
+    for (auto& entry : series) {
+        Series& target = entry.second;
+        std::vector<Segment> segments = target.manifest->dropBefore(cutoff);
+        for (const Segment& segment : segments) {
+            if (target.writer.is_open() && target.writerSegment == segment.start) {
+                target.writer.close();
+            }
+            target.indexes.erase(segment.start);
+            target.records.erase(segment.start);
+            std::error_code error;
+            std::filesystem::remove(segment.path, error);
+            if (error) {
+                std::cerr << "Can't remove " << segment.path << ": " << error.message() << std::endl;
+            }
+            if (engine == StorageEngine::TEXT) {
+                std::filesystem::remove(segment.path + ".idx", error);
+            }
+            ++dropped;
+        }
+        if (!segments.empty()) {
+            loadEnds(target);
+        }
+    }
+    return dropped;
+}
+
+std::int64_t SegmentStore::dropBoundary(std::int64_t cutoff) const {
+    return cutoff - ((cutoff % segmentSeconds) + segmentSeconds) % segmentSeconds;
+}
@@ -0,0 +1,74 @@
+#ifndef SEGMENT_STORE_H
+#define SEGMENT_STORE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <shared_mutex>
+#include "storage_backend.h"
+#include "segment_manifest.h"
+#include "text_index.h"
+#include "record_file.h"
+
+// Samples in time segments of segmentSeconds, one SegmentManifest per sensor
+// in <directory>/<sensor>. TEXT segments are "<start>.txt" files with one
+// "YYYY-MM-DD HH:MM:SS [temperature]" line per sample in local time and a
+// TextIndex each; RECORDS segments are "<start>.bin" RecordFiles. A read opens
+// only the segments its range overlaps and seeks inside them, and retention
+// unlinks whole segments, so old samples are never rewritten.
+//
+// Samples must arrive in epoch order per sensor; a sample that is not newer
+// than the sensor's last one is rejected. Text lines are buffered and reach
+// the file on flush(); records are written straight away.
+class SegmentStore : public StorageBackend {
+private:
+    struct Series {
+        std::unique_ptr<SegmentManifest> manifest;
+        // Opened on first use, keyed by segment start.
+        mutable std::map<std::int64_t, std::unique_ptr<TextIndex>> indexes;
+        mutable std::map<std::int64_t, std::unique_ptr<RecordFile>> records;
+        std::ofstream writer;
+        std::int64_t writerSegment = 0;
+        bool hasSamples = false;
+        Sample first;
+        Sample last;
+    };
+
+    std::string directory;
+    StorageEngine engine;
+    std::int64_t segmentSeconds;
+    std::map<int, Series> series;
+    mutable std::shared_mutex mutex;
+    // Readers share mutex but may open segments, which they do under this one.
+    mutable std::mutex openMutex;
+
+    Series& seriesFor(int sensor);
+    bool firstOf(const Series& target, const Segment& segment, Sample& sample) const;
+    void loadEnds(Series& target);
+    TextIndex& indexFor(const Series& target, const Segment& segment) const;
+    RecordFile& recordsFor(const Series& target, const Segment& segment) const;
+    void readSegment(const Series& target, const Segment& segment, std::int64_t start, std::int64_t end,
+                     std::vector<Sample>& output) const;
+
+public:
+    // engine is TEXT or RECORDS.
+    SegmentStore(const std::string& directory, StorageEngine engine, std::int64_t segmentSeconds);
+
+    // Creates the directory if needed and loads every sensor's manifest.
+    bool open() override;
+
+    bool append(int sensor, const Sample& sample) override;
+    void flush() override;
+
+    std::unique_ptr<SampleCursor> scan(int sensor, std::int64_t start, std::int64_t end) const override;
+    Bucket summarize(int sensor, std::int64_t start, std::int64_t end) const override;
+    bool firstSample(int sensor, Sample& sample) const override;
+    bool lastSample(int sensor, Sample& sample) const override;
+
+    // Deletes the segments of every sensor that end at or before cutoff.
+    size_t dropBefore(std::int64_t cutoff) override;
+    std::int64_t dropBoundary(std::int64_t cutoff) const override;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "storage_backend.h"
+#include "segment_store.h"
+#include "memory_backend.h"
+#include "block_store.h"
+
+size_t StorageBackend::appendBatch(int sensor, const std::vector<Sample>& samples) {
+    size_t stored = 0;
+    for (const Sample& sample : samples) {
+        if (append(sensor, sample)) {
+            ++stored;
+        }
+    }
+    flush();
+    return stored;
+}
+
+bool parseStorageEngine(const std::string& name, StorageEngine& engine) {
+    if (name == "sqlite") {
+        engine = StorageEngine::SQLITE;
+    } else if (name == "text") {
+        engine = StorageEngine::TEXT;
+    } else if (name == "records") {
+        engine = StorageEngine::RECORDS;
+    } else if (name == "memory") {
+        engine = StorageEngine::MEMORY;
+    } else if (name == "blocks") {
+        engine = StorageEngine::BLOCKS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* storageEngineName(StorageEngine engine) {
+    switch (engine) {
+        case StorageEngine::SQLITE:
+            return "sqlite";
+        case StorageEngine::TEXT:
+            return "text";
+        case StorageEngine::RECORDS:
+            return "records";
+        case StorageEngine::MEMORY:
+            return "memory";
+        case StorageEngine::BLOCKS:
+            return "blocks";
+    }
+    return "";
+}
+
+std::unique_ptr<StorageBackend> makeFileBackend(StorageEngine engine, const std::string& stem,
+                                                std::int64_t segmentSeconds) {
+    std::string directory = stem + "." + storageEngineName(engine);
+    switch (engine) {
+        case StorageEngine::TEXT:
+        case StorageEngine::RECORDS:
+            return std::make_unique<SegmentStore>(directory, engine, segmentSeconds);
+        case StorageEngine::MEMORY:
+            return std::make_unique<MemoryBackend>();
+        case StorageEngine::BLOCKS:
+            return std::make_unique<BlockStore>(directory);
+        case StorageEngine::SQLITE:
+            break;
+    }
+    return nullptr;
+}
@@ -0,0 +1,72 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "sample.h"
+#include "sample_cursor.h"
+
+// SQLITE belongs to the server (Task5), which links SQLite; the others are
+// the file and memory engines in this directory.
+enum class StorageEngine {
+    SQLITE,
+    TEXT,
+    RECORDS,
+    MEMORY,
+    BLOCKS
+};
+
+// Where one measurement table keeps its samples. Both tasks' DataAggregators
+// only talk to this interface, so the ingest and rollup code runs unchanged on
+// any engine.
+//
+// Writes must be serialised by the caller; reads may run alongside them. SQLite
+// replaces a sample whose (sensor, epoch) already exists, the other engines are
+// append-only and reject a sample that is not newer than the sensor's last one.
+class StorageBackend {
+public:
+    virtual ~StorageBackend() = default;
+
+    virtual bool open() = 0;
+
+    // False when the sample was not stored.
+    virtual bool append(int sensor, const Sample& sample) = 0;
+    // Samples in epoch order, stored as one write. Returns how many were kept.
+    virtual size_t appendBatch(int sensor, const std::vector<Sample>& samples);
+    // Makes every appended sample durable.
+    virtual void flush() {}
+
+    // Samples with start <= epoch <= end, in epoch order.
+    virtual std::unique_ptr<SampleCursor> scan(int sensor, std::int64_t start, std::int64_t end) const = 0;
+    // Count, sum, min and max of the samples in [start, end).
+    virtual Bucket summarize(int sensor, std::int64_t start, std::int64_t end) const = 0;
+    virtual bool firstSample(int sensor, Sample& sample) const = 0;
+    virtual bool lastSample(int sensor, Sample& sample) const = 0;
+
+    // Removes samples older than cutoff for every sensor. Engines that store
+    // whole days may keep up to one day before cutoff; nothing at or after it
+    // is removed. Returns the number of rows, partitions or files dropped.
+    virtual size_t dropBefore(std::int64_t cutoff) = 0;
+    // The latest time at or before cutoff that dropBefore removes every
+    // sample before, such as the start of the day or partition it falls in.
+    virtual std::int64_t dropBoundary(std::int64_t cutoff) const { return cutoff; }
+
+    // True if append() replaces a sample stored for the same (sensor, epoch)
+    // instead of rejecting it.
+    virtual bool replacesSamples() const { return false; }
+};
+
+// "sqlite", "text", "records", "memory" or "blocks".
+bool parseStorageEngine(const std::string& name, StorageEngine& engine);
+const char* storageEngineName(StorageEngine engine);
+
+// A file or memory engine for the data named stem, kept in the directory
+// <stem>.<engine name>. Text and records split it into segments of
+// segmentSeconds, which must be a multiple of a day or divide one. Null for
+// SQLITE.
+std::unique_ptr<StorageBackend> makeFileBackend(StorageEngine engine, const std::string& stem,
+                                                std::int64_t segmentSeconds);
+
+#endif
@@ -0,0 +1,175 @@
+#include "summary_store.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+SummaryStore::SummaryStore(const StorageBackend& backend, std::int64_t sliceSeconds, const std::string& path) :
+    backend(backend), sliceSeconds(sliceSeconds), path(path), changed(false) {}
+
+std::int64_t SummaryStore::sliceOf(std::int64_t epoch) const {
+    return epoch - ((epoch % sliceSeconds) + sliceSeconds) % sliceSeconds;
+}
+
+SummaryStore::SensorSummary& SummaryStore::summaryFor(int sensor) {
+    auto it = summaries.find(sensor);
+    if (it != summaries.end()) {
+        return it->second;
+    }
+    SensorSummary& summary = summaries[sensor];
+    summary.total = SeriesSummary{0, 0, 0, 0.0, 0.0};
+    Sample first, last;
+    if (backend.firstSample(sensor, first) && backend.lastSample(sensor, last)) {
+        countSamples(sensor, summary, first.epoch, last.epoch);
+    }
+    changed = true;
+    return summary;
+}
+
+static void addSample(SeriesSummary& summary, const Sample& sample, bool replaces) {
+    if (replaces) {
+        summary.sum += sample.temperature - summary.lastTemperature;
+    } else {
+        if (summary.count == 0 || sample.epoch < summary.first) {
+            summary.first = sample.epoch;
+        }
+        summary.count += 1;
+        summary.sum += sample.temperature;
+    }
+    if (summary.count == 1 || sample.epoch >= summary.last) {
+        summary.last = sample.epoch;
+        summary.lastTemperature = sample.temperature;
+    }
+}
+
+// SQLite replaces a sample stored for the same second; ingest only does that
+// to the newest one. An older out-of-order sample is counted as a new one.
+void SummaryStore::addTo(SensorSummary& summary, const Sample& sample) {
+    bool replaces = backend.replacesSamples() && summary.total.count > 0 && sample.epoch == summary.total.last;
+    SeriesSummary& part = summary.slices.emplace(sliceOf(sample.epoch), SeriesSummary{0, 0, 0, 0.0, 0.0}).first->second;
+    addSample(summary.total, sample, replaces);
+    addSample(part, sample, replaces);
+    changed = true;
+}
+
+void SummaryStore::countSamples(int sensor, SensorSummary& summary, std::int64_t start, std::int64_t end) {
+    std::unique_ptr<SampleCursor> cursor = backend.scan(sensor, start, end);
+    for (Sample sample; cursor->next(sample);) {
+        addTo(summary, sample);
+    }
+}
+
+static void rebuildTotal(const std::map<std::int64_t, SeriesSummary>& slices, SeriesSummary& total) {
+    total = SeriesSummary{0, 0, 0, 0.0, 0.0};
+    for (const auto& entry : slices) {
+        const SeriesSummary& part = entry.second;
+        if (part.count == 0) continue;
+        if (total.count == 0) {
+            total.first = part.first;
+        }
+        total.last = part.last;
+        total.lastTemperature = part.lastTemperature;
+        total.count += part.count;
+        total.sum += part.sum;
+    }
+}
+
+void SummaryStore::load() {
+    summaries.clear();
+    std::map<int, SensorSummary> saved;
+    std::ifstream infile(path);
+    std::string line;
+    while (std::getline(infile, line)) {
+        std::istringstream fields(line);
+        int sensor;
+        long long slice, first, last, count;
+        double sum, lastTemperature;
+        if (fields >> sensor >> slice >> first >> last >> count >> sum >> lastTemperature && count > 0) {
+            saved[sensor].slices[slice] = SeriesSummary{first, last, count, sum, lastTemperature};
+        }
+    }
+
+    for (auto& entry : saved) {
+        int sensor = entry.first;
+        SensorSummary& summary = entry.second;
+        rebuildTotal(summary.slices, summary.total);
+        Sample oldest, newest;
+        if (!backend.firstSample(sensor, oldest) || !backend.lastSample(sensor, newest) ||
+            oldest.epoch != summary.total.first || newest.epoch < summary.total.last) {
+            changed = true;
+            continue;
+        }
+        // Only the newest saved slice can have changed since the save;
+        // it and every sample after it are counted again.
+        SensorSummary& loaded = summaries[sensor];
+        loaded = std::move(summary);
+        std::int64_t tail = loaded.slices.rbegin()->first;
+        loaded.slices.erase(tail);
+        rebuildTotal(loaded.slices, loaded.total);
+        countSamples(sensor, loaded, tail, newest.epoch);
+    }
+}
+
+void SummaryStore::save() {
+    if (!changed || path.empty()) return;
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream outfile(temporary, std::ios_base::trunc);
+        if (!outfile.is_open()) {
+            std::cerr << "Error opening file for writing: " << temporary << std::endl;
+            return;
+        }
+        outfile << std::setprecision(17);
+        for (const auto& entry : summaries) {
+            for (const auto& slice : entry.second.slices) {
+                const SeriesSummary& part = slice.second;
+                if (part.count == 0) continue;
+                outfile << entry.first << ' ' << slice.first << ' ' << part.first << ' ' << part.last << ' '
+                        << part.count << ' ' << part.sum << ' ' << part.lastTemperature << '\n';
+            }
+        }
+        if (!outfile) {
+            std::cerr << "Error writing file: " << temporary << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::cerr << "Can't replace " << path << ": " << error.message() << std::endl;
+        std::remove(temporary.c_str());
+        return;
+    }
+    changed = false;
+}
+
+const SeriesSummary& SummaryStore::get(int sensor) {
+    return summaryFor(sensor).total;
+}
+
+// A sensor seen for the first time is counted from the backend, whose scan
+// may or may not see sample yet: a text engine buffers it until flush().
+void SummaryStore::add(int sensor, const Sample& sample) {
+    bool known = summaries.count(sensor) > 0;
+    SensorSummary& summary = summaryFor(sensor);
+    if (known && !summary.slices.empty() && summary.slices.count(sliceOf(sample.epoch)) == 0) {
+        save();
+    }
+    if (known || summary.total.count == 0 || summary.total.last < sample.epoch) {
+        addTo(summary, sample);
+    }
+}
+
+void SummaryStore::dropBefore(std::int64_t cutoff) {
+    for (auto& entry : summaries) {
+        std::map<std::int64_t, SeriesSummary>& slices = entry.second.slices;
+        auto firstKept = slices.lower_bound(cutoff);
+        if (firstKept != slices.begin()) {
+            slices.erase(slices.begin(), firstKept);
+            rebuildTotal(slices, entry.second.total);
+            changed = true;
+        }
+    }
+}
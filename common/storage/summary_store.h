@@ -0,0 +1,67 @@
+#ifndef SUMMARY_STORE_H
+#define SUMMARY_STORE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include "storage_backend.h"
+
+// Oldest and newest epoch, number and sum of one sensor's samples, and the
+// newest temperature; count is 0 when there are none.
+struct SeriesSummary {
+    std::int64_t first;
+    std::int64_t last;
+    std::int64_t count;
+    double sum;
+    double lastTemperature;
+};
+
+// Per-sensor summaries of what a backend holds, and the same for each UTC
+// slice of sliceSeconds a sensor has samples in, keyed by slice start. The
+// owner reports every stored sample with add(); retention drops whole slices
+// and subtracts them, so it never reads the dropped samples.
+//
+// Saved to path as "sensor slice first last count sum lastTemperature" lines
+// (nothing is saved when path is empty) by save() and before add() starts a
+// new slice, so after a crash only the newest saved slice and the samples
+// after it can be out of date. On load a saved summary is kept if it still starts
+// at the sensor's first sample and the backend holds its last; that slice
+// and the tail after it are counted from the backend again. A sensor without
+// a usable one is counted from the backend on first use.
+//
+// Not thread-safe: the owner serialises calls along with its writes.
+class SummaryStore {
+private:
+    struct SensorSummary {
+        SeriesSummary total;
+        std::map<std::int64_t, SeriesSummary> slices;
+    };
+
+    const StorageBackend& backend;
+    std::int64_t sliceSeconds;
+    std::string path;
+    std::map<int, SensorSummary> summaries;
+    bool changed;
+
+    std::int64_t sliceOf(std::int64_t epoch) const;
+    SensorSummary& summaryFor(int sensor);
+    void addTo(SensorSummary& summary, const Sample& sample);
+    void countSamples(int sensor, SensorSummary& summary, std::int64_t start, std::int64_t end);
+
+public:
+    SummaryStore(const StorageBackend& backend, std::int64_t sliceSeconds, const std::string& path);
+
+    // Call once the backend is open.
+    void load();
+    void save();
+
+    const SeriesSummary& get(int sensor);
+    // Records a sample the backend has just stored, saving first if it
+    // starts a new slice.
+    void add(int sensor, const Sample& sample);
+    // Forgets the slices that start before cutoff, a slice start before which
+    // the backend has just dropped every sample.
+    void dropBefore(std::int64_t cutoff);
+};
+
+#endif
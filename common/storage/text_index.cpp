@@ -0,0 +1,116 @@
+#include "text_index.h"
+#include "timestamp.h"
+#include <fstream>
+#include <ctime>
+#include <filesystem>
+#include <cstdio>
+
+#define INDEX_STRIDE 128
+
+static bool lineEpoch(const std::string& line, std::int64_t& epoch) {
+    return line.length() >= TIMESTAMP_LENGTH && parseLocalTimestamp(line.c_str(), TIMESTAMP_LENGTH, epoch);
+}
+
+TextIndex::TextIndex(const std::string& dataPath) :
+    dataPath(dataPath), indexPath(dataPath + ".idx"), endOffset(0), lastEpoch(0), linesSinceEntry(0), empty(true) {}
+
+bool TextIndex::entryMatches(const Entry& entry) const {
+    std::ifstream infile(dataPath, std::ios_base::binary);
+    infile.seekg(static_cast<std::streamoff>(entry.offset));
+    std::string line;
+    std::int64_t epoch;
+    return std::getline(infile, line) && lineEpoch(line, epoch) && epoch == entry.epoch;
+}
+
+void TextIndex::addEntry(std::int64_t epoch, std::uint64_t offset, bool persist) {
+    entries.push_back(Entry{epoch, offset});
+    linesSinceEntry = 0;
+    if (persist) {
+        std::ofstream sidecar(indexPath, std::ios_base::app);
+        sidecar << epoch << ' ' << offset << '\n';
+    }
+}
+
+// Reads the data file from offset to its end, indexing every stride-th line.
+// startsWithEntry says the line at offset is already the last entry.
+void TextIndex::indexFrom(std::uint64_t offset, bool startsWithEntry) {
+    std::ifstream infile(dataPath, std::ios_base::binary);
+    infile.seekg(static_cast<std::streamoff>(offset));
+    std::string line;
+    bool first = true;
+    while (std::getline(infile, line)) {
+        std::uint64_t lineOffset = offset;
+        offset += line.size() + 1;
+        std::int64_t epoch;
+        if (!lineEpoch(line, epoch)) {
+            continue;
+        }
+        if (first && startsWithEntry) {
+            linesSinceEntry = 1;
+        } else if (entries.empty() || linesSinceEntry >= INDEX_STRIDE) {
+            addEntry(epoch, lineOffset, true);
+            linesSinceEntry = 1;
+        } else {
+            ++linesSinceEntry;
+        }
+        first = false;
+        lastEpoch = epoch;
+        empty = false;
+    }
+    // A last line without its newline ends at the file size, not one past it.
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(dataPath, error);
+    endOffset = error ? 0 : static_cast<std::uint64_t>(size);
+}
+
+void TextIndex::load() {
+    entries.clear();
+    std::ifstream sidecar(indexPath);
+    long long epoch;
+    unsigned long long offset;
+    while (sidecar >> epoch >> offset) {
+        entries.push_back(Entry{epoch, offset});
+    }
+    sidecar.close();
+
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(dataPath, error);
+    if (entries.empty() || error || entries.back().offset >= size ||
+        !entryMatches(entries.front()) || !entryMatches(entries.back())) {
+        rebuild();
+        return;
+    }
+    indexFrom(entries.back().offset, true);
+}
+
+void TextIndex::rebuild() {
+    entries.clear();
+    std::remove(indexPath.c_str());
+    linesSinceEntry = 0;
+    lastEpoch = 0;
+    empty = true;
+    indexFrom(0, false);
+}
+
+void TextIndex::onAppend(std::int64_t epoch, size_t lineBytes) {
+    if (entries.empty() || linesSinceEntry >= INDEX_STRIDE) {
+        addEntry(epoch, endOffset, true);
+    }
+    ++linesSinceEntry;
+    endOffset += lineBytes;
+    lastEpoch = epoch;
+    empty = false;
+}
+
+std::uint64_t TextIndex::seekOffset(std::int64_t epoch) const {
+    size_t low = 0, high = entries.size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (entries[middle].epoch < epoch) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == 0 ? 0 : entries[low - 1].offset;
+}
@@ -0,0 +1,54 @@
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Sparse index over a text data file: the epoch and byte offset of every
+// INDEX_STRIDE-th line, kept in memory and in a sidecar "<file>.idx" that is
+// appended to as the data file grows. A reader seeks to the last indexed line
+// before its window instead of parsing the file from the top.
+//
+// On load the sidecar is checked against the data file: its first and last
+// entries must point at lines with the recorded epochs. Lines appended after
+// the last entry are indexed by reading just that tail; anything else that
+// does not match rebuilds the index from the whole file.
+class TextIndex {
+private:
+    struct Entry {
+        std::int64_t epoch;
+        std::uint64_t offset;
+    };
+
+    std::string dataPath;
+    std::string indexPath;
+    std::vector<Entry> entries;
+    std::uint64_t endOffset;
+    std::int64_t lastEpoch;
+    size_t linesSinceEntry;
+    bool empty;
+
+    bool entryMatches(const Entry& entry) const;
+    void indexFrom(std::uint64_t offset, bool startsWithEntry);
+    void addEntry(std::int64_t epoch, std::uint64_t offset, bool persist);
+
+public:
+    explicit TextIndex(const std::string& dataPath);
+
+    void load();
+    void rebuild();
+
+    // Newest epoch in the file; only valid when !isEmpty().
+    bool isEmpty() const { return empty; }
+    std::int64_t getLastEpoch() const { return lastEpoch; }
+    // Offset where the next appended line starts.
+    std::uint64_t getEndOffset() const { return endOffset; }
+
+    // Records a line of lineBytes bytes just appended at getEndOffset().
+    void onAppend(std::int64_t epoch, size_t lineBytes);
+    // Offset to start reading at to see every line with epoch >= epoch.
+    std::uint64_t seekOffset(std::int64_t epoch) const;
+};
+
+#endif
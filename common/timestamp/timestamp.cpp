@@ -0,0 +1,199 @@
+#include "timestamp.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+#define OFFSET_WINDOW (15 * 60)
+#define OFFSET_CACHE_SIZE 4
+#define DAY_SECONDS (24 * 60 * 60)
+
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static std::int64_t floorDiv(std::int64_t value, std::int64_t divisor) {
+    std::int64_t quotient = value / divisor;
+    return quotient - (value % divisor < 0 ? 1 : 0);
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back (H. Hinnant's
+// algorithms); they avoid timegm(), which Windows lacks.
+std::int64_t daysFromCivil(std::int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2 ? 1 : 0;
+    std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<std::int64_t>(dayOfEra) - 719468;
+}
+
+static void civilFromDays(std::int64_t days, std::int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    year = static_cast<std::int64_t>(yearOfEra) + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+static unsigned daysInMonth(std::int64_t year, unsigned month) {
+    static const unsigned char days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) {
+        return 29;
+    }
+    return month >= 1 && month <= 12 ? days[month - 1] : 0;
+}
+
+// Parsing looks up two windows, the local time read as UTC and the result,
+// so the cache keeps a few of them and replaces the oldest.
+std::int64_t localUtcOffset(std::int64_t epoch) {
+    struct Entry {
+        std::int64_t window;
+        std::int64_t offset;
+    };
+    const std::int64_t none = std::numeric_limits<std::int64_t>::min();
+    thread_local Entry cache[OFFSET_CACHE_SIZE] = {{none, 0}, {none, 0}, {none, 0}, {none, 0}};
+    thread_local unsigned oldest = 0;
+
+    std::int64_t window = floorDiv(epoch, OFFSET_WINDOW);
+    for (const Entry& entry : cache) {
+        if (entry.window == window) {
+            return entry.offset;
+        }
+    }
+
+    std::time_t time = static_cast<std::time_t>(window * OFFSET_WINDOW);
+    std::tm localTime{};
+#if defined(_WIN32)
+    localtime_s(&localTime, &time);
+#else
+    localtime_r(&time, &localTime);
+#endif
+    std::int64_t local = daysFromCivil(localTime.tm_year + 1900, localTime.tm_mon + 1, localTime.tm_mday) * DAY_SECONDS +
+                         localTime.tm_hour * 3600 + localTime.tm_min * 60 + localTime.tm_sec;
+    Entry& entry = cache[oldest];
+    entry = Entry{window, local - static_cast<std::int64_t>(time)};
+    oldest = (oldest + 1) % OFFSET_CACHE_SIZE;
+    return entry.offset;
+}
+
+std::int64_t epochToLocal(std::int64_t epoch) {
+    return epoch + localUtcOffset(epoch);
+}
+
+// The offset is guessed from the local time read as UTC, then checked at the
+// epoch it gives; they only disagree around a DST change.
+std::int64_t localToEpoch(std::int64_t localSeconds) {
+    std::int64_t offset = localUtcOffset(localSeconds - localUtcOffset(localSeconds));
+    std::int64_t epoch = localSeconds - offset;
+    std::int64_t actual = localUtcOffset(epoch);
+    if (actual != offset) {
+        epoch = localSeconds - actual;
+    }
+    return epoch;
+}
+
+// Value of the two digits at text; bad becomes non-zero if either is not a
+// digit. Comparisons instead of branches keep the parse straight-line code.
+static unsigned twoDigits(const char* text, unsigned& bad) {
+    unsigned high = static_cast<unsigned char>(text[0]) - '0';
+    unsigned low = static_cast<unsigned char>(text[1]) - '0';
+    bad |= static_cast<unsigned>(high > 9) | static_cast<unsigned>(low > 9);
+    return high * 10 + low;
+}
+
+bool parseLocalTimestamp(const char* text, size_t length, std::int64_t& epoch) {
+    if (length != 10 && length != 16 && length != TIMESTAMP_LENGTH) {
+        return false;
+    }
+
+    unsigned bad = 0;
+    std::int64_t year = twoDigits(text, bad) * 100 + twoDigits(text + 2, bad);
+    unsigned month = twoDigits(text + 5, bad);
+    unsigned day = twoDigits(text + 8, bad);
+    bad |= static_cast<unsigned>(text[4] != '-') | static_cast<unsigned>(text[7] != '-');
+
+    unsigned hour = 0, minute = 0, second = 0;
+    if (length >= 16) {
+        hour = twoDigits(text + 11, bad);
+        minute = twoDigits(text + 14, bad);
+        bad |= static_cast<unsigned>(text[10] != ' ') | static_cast<unsigned>(text[13] != ':');
+    }
+    if (length == TIMESTAMP_LENGTH) {
+        second = twoDigits(text + 17, bad);
+        bad |= static_cast<unsigned>(text[16] != ':');
+    }
+    // A leap second reads as the first second of the next minute, as with mktime.
+    bad |= static_cast<unsigned>(day == 0) | static_cast<unsigned>(day > daysInMonth(year, month)) |
+           static_cast<unsigned>(hour > 23) | static_cast<unsigned>(minute > 59) | static_cast<unsigned>(second > 60);
+    if (bad) {
+        return false;
+    }
+
+    std::int64_t local = daysFromCivil(year, month, day) * DAY_SECONDS + hour * 3600 + minute * 60 + second;
+    epoch = localToEpoch(local);
+    return true;
+}
+
+bool parseLocalTimestamp(const std::string& text, std::int64_t& epoch) {
+    if (text.empty()) {
+        return false;
+    }
+
+    if (text.find('-', 1) == std::string::npos) {
+        char* parseEnd = nullptr;
+        long long value = std::strtoll(text.c_str(), &parseEnd, 10);
+        if (*parseEnd != '\0') {
+            return false;
+        }
+        epoch = value;
+        return true;
+    }
+    return parseLocalTimestamp(text.c_str(), text.size(), epoch);
+}
+
+void formatLocalTimestamp(std::int64_t epoch, char* buffer, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    char text[TIMESTAMP_BUFFER_SIZE];
+    char* output = size >= TIMESTAMP_BUFFER_SIZE ? buffer : text;
+
+    std::int64_t local = epochToLocal(epoch);
+    std::int64_t days = floorDiv(local, DAY_SECONDS);
+    unsigned secondOfDay = static_cast<unsigned>(local - days * DAY_SECONDS);
+    std::int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    unsigned shownYear = static_cast<unsigned>(year < 0 ? 0 : year > 9999 ? 9999 : year);
+
+    std::memcpy(output, digitPairs + 2 * (shownYear / 100), 2);
+    std::memcpy(output + 2, digitPairs + 2 * (shownYear % 100), 2);
+    output[4] = '-';
+    std::memcpy(output + 5, digitPairs + 2 * month, 2);
+    output[7] = '-';
+    std::memcpy(output + 8, digitPairs + 2 * day, 2);
+    output[10] = ' ';
+    std::memcpy(output + 11, digitPairs + 2 * (secondOfDay / 3600), 2);
+    output[13] = ':';
+    std::memcpy(output + 14, digitPairs + 2 * (secondOfDay / 60 % 60), 2);
+    output[16] = ':';
+    std::memcpy(output + 17, digitPairs + 2 * (secondOfDay % 60), 2);
+    output[TIMESTAMP_LENGTH] = '\0';
+
+    if (output == text) {
+        std::memcpy(buffer, text, size - 1);
+        buffer[size - 1] = '\0';
+    }
+}
+
+std::string formatLocalTimestamp(std::int64_t epoch) {
+    char buffer[TIMESTAMP_BUFFER_SIZE];
+    formatLocalTimestamp(epoch, buffer, sizeof(buffer));
+    return std::string(buffer, TIMESTAMP_LENGTH);
+}
@@ -0,0 +1,39 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Conversions between UTC epoch seconds and local "YYYY-MM-DD HH:MM:SS"
+// text. They do their own digit and calendar arithmetic; the only libc call
+// is a localtime lookup of the UTC offset, made once per thread for each
+// 15-minute stretch of time and cached. DST changes fall on those boundaries.
+// Changing the time zone of a running process is not noticed.
+
+#define TIMESTAMP_LENGTH 19
+// TIMESTAMP_LENGTH characters and the terminating NUL.
+#define TIMESTAMP_BUFFER_SIZE 20
+
+// Accepts "YYYY-MM-DD", "YYYY-MM-DD HH:MM" or "YYYY-MM-DD HH:MM:SS" in local
+// time, or a plain integer epoch. Returns false for anything else.
+bool parseLocalTimestamp(const std::string& text, std::int64_t& epoch);
+// The same three text forms, exactly length characters at text.
+bool parseLocalTimestamp(const char* text, size_t length, std::int64_t& epoch);
+
+// Writes epoch as local "YYYY-MM-DD HH:MM:SS" into buffer, cut to size - 1
+// characters if size < TIMESTAMP_BUFFER_SIZE.
+void formatLocalTimestamp(std::int64_t epoch, char* buffer, size_t size);
+std::string formatLocalTimestamp(std::int64_t epoch);
+
+// Seconds east of UTC in effect at epoch.
+std::int64_t localUtcOffset(std::int64_t epoch);
+// Days since 1970-01-01 of a proleptic Gregorian date; no time zone involved.
+std::int64_t daysFromCivil(std::int64_t year, unsigned month, unsigned day);
+
+// Local time as seconds since 1970-01-01 00:00:00 local, and back. A local
+// time skipped when the clocks go forward maps to the epoch an hour later.
+std::int64_t epochToLocal(std::int64_t epoch);
+std::int64_t localToEpoch(std::int64_t localSeconds);
+
+#endif